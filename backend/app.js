@@ -2,6 +2,13 @@ const express = require('express');
 const logger = require('morgan');
 const cookieParser = require('cookie-parser');
 const db = require('./db');
+const { fairQueue } = require('./fairQueue');
+const { limitAuth } = require('./rateLimiter');
+const { parseDeadline } = require('./deadline');
+const { traceRequests, traceEvents } = require('./trace');
+const metrics = require('./metrics');
+const limits = require('./limits');
+const withdrawals = require('./withdrawals');
 
 cardsRouter = require('./routes/cards');
 transactionsRoutes = require('./routes/transactions');
@@ -10,28 +17,39 @@ customersRoutes = require('./routes/customers');
 
 const app = express();
 
+// JSON API: ei ETag-laskentaa eikä X-Powered-By-otsaketta jokaiseen vastaukseen
+app.disable('x-powered-by');
+app.set('etag', false);
+
 app.use(logger('dev'));
 app.use(express.json());
 app.use(express.urlencoded({ extended: false }));
 app.use(cookieParser());
-
-app.use((req, res, next) => {
-    console.log(`[${new Date().toISOString()}] Incoming request: ${req.method} ${req.url}`);
-    console.log('Request body:', req.body);
-    next();
-});
+app.use(parseDeadline);
+app.use(traceRequests);
 
 app.get('/test', (req, res) => {
     res.status(200).json({ message: 'Server is running' });
 });
 
-app.use('/cards', cardsRouter);
-app.use('/transactions', transactionsRoutes);
+app.get('/metrics', (req, res) => {
+    res.status(200).json(metrics.snapshot());
+});
+
+app.get('/trace/:traceId', (req, res) => {
+    res.status(200).json({ traceEvents: traceEvents(req.params.traceId) });
+});
+
+// Kirjautumisyritysten rajoitin ennen jonoa: hylättävät yritykset eivät vie jonopaikkaa
+// eivätkä odota jonossa ennen 429-vastausta
+app.post('/cards/auth', limitAuth);
+app.use('/cards', fairQueue, cardsRouter);
+app.use('/transactions', fairQueue, transactionsRoutes);
 app.use('/accounts', accountsRoutes);
 app.use('/customers', customersRoutes);
 
 const port = 3000;
-app.listen(port, async () => {
+const server = app.listen(port, async () => {
     console.log(`Server running on http://localhost:${port}`);
 
     try {
@@ -42,6 +60,38 @@ app.listen(port, async () => {
     }
 });
 
+// Pidä automaattien keep-alive-yhteydet auki istuntojen välillä,
+// jotta jokainen pyyntö ei avaa uutta TCP-yhteyttä
+server.keepAliveTimeout = 65000;
+server.headersTimeout = 66000;
+
+// Hallittu sammutus: uusia yhteyksiä ei oteta, käynnissä olevat nostot saavat valmistua
+// (ja varata tai vapauttaa rajansa), ja nostorajat ja -viitteet tallennetaan vasta sen jälkeen
+const SHUTDOWN_TIMEOUT_MS = parseInt(process.env.SHUTDOWN_TIMEOUT_MS, 10) || 10000;
+
+const shutdown = (signal) => {
+    console.log(`${signal} vastaanotettu, suljetaan palvelin`);
+    const forced = setTimeout(() => {
+        console.error('Sammutuksen aikaraja ylittyi, suljetaan keskeneräiset yhteydet');
+        limits.checkpoint();
+        withdrawals.checkpoint();
+        process.exit(1);
+    }, SHUTDOWN_TIMEOUT_MS);
+    forced.unref();
+
+    server.close(() => {
+        limits.checkpoint();
+        withdrawals.checkpoint();
+        process.exit(0);
+    });
+    // Joutilaat keep-alive-yhteydet pitäisivät close-kutsun auki keepAliveTimeoutin ajan
+    server.closeIdleConnections();
+};
+
+for (const signal of ['SIGINT', 'SIGTERM']) {
+    process.once(signal, () => shutdown(signal));
+}
+
 process.on('uncaughtException', (err) => {
     console.error('Uncaught Exception:', err);
 });
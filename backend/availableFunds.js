@@ -0,0 +1,68 @@
+// Tilikohtainen saldo ja nostettavissa oleva määrä välimuistissa. Kirjaukset päivittävät
+// molemmat suoraan (post), joten nosto- ja saldokysely tarvitsevat vain yhden haun.
+// Summat sentteinä, jotta toistuvat kirjaukset eivät kerrytä pyöristysvirhettä.
+// TTL rajaa, kuinka kauan muiden prosessien (esim. korkoajon) muutokset voivat näkyä viiveellä.
+
+const accountsModel = require('./models/account_model');
+
+const TTL_MS = parseInt(process.env.AVAILABLE_FUNDS_TTL_MS, 10) || 60000;
+const MAX_ENTRIES = parseInt(process.env.AVAILABLE_FUNDS_MAX_ENTRIES, 10) || 100000;
+
+const cache = new Map();
+
+const toCents = (value) => Math.round(parseFloat(value) * 100);
+
+// Sama sääntö kuin nostossa: luottokortilla raja miinus käytetty luotto, debitillä saldo
+const computeAvailable = (balanceCents, creditLimitCents) => {
+    if (creditLimitCents === null) return Math.max(0, balanceCents);
+    return creditLimitCents - (balanceCents < 0 ? -balanceCents : 0);
+};
+
+const creditLimitOf = (card) => (card.card_type === 'credit' && card.credit_limit !== null && card.credit_limit !== undefined
+    ? toCents(card.credit_limit)
+    : null);
+
+const store = (accountId, balanceCents, creditLimitCents) => {
+    // Map säilyttää lisäysjärjestyksen: vanhin merkintä poistetaan ensin
+    cache.delete(accountId);
+    if (cache.size >= MAX_ENTRIES) cache.delete(cache.keys().next().value);
+    const entry = {
+        balanceCents,
+        creditLimitCents,
+        availableCents: computeAvailable(balanceCents, creditLimitCents),
+        loadedAt: Date.now()
+    };
+    cache.set(accountId, entry);
+    return entry;
+};
+
+// Palauttaa { balanceCents, creditLimitCents, availableCents } kortin tilille.
+// Null, jos tiliä ei ole.
+const lookup = async (card) => {
+    const accountId = Number(card.account_id);
+    const creditLimitCents = creditLimitOf(card);
+    const entry = cache.get(accountId);
+    if (entry && Date.now() - entry.loadedAt < TTL_MS && entry.creditLimitCents === creditLimitCents) {
+        return entry;
+    }
+
+    const account = await accountsModel.getOne(accountId);
+    if (!Array.isArray(account) || account.length === 0) return null;
+    return store(accountId, toCents(account[0].balance), creditLimitCents);
+};
+
+// Kirjauksen jälkeen: kirjaustransaktiossa luettu saldo päivitetään välimuistiin. Välimuistin
+// oma saldo voi olla TTL:n verran vanha (esim. korkoajo), joten siihen ei lisätä muutosta.
+const post = (accountId, balanceCents) => {
+    const entry = cache.get(Number(accountId));
+    if (!entry) return;
+    entry.balanceCents = balanceCents;
+    entry.availableCents = computeAvailable(entry.balanceCents, entry.creditLimitCents);
+    entry.loadedAt = Date.now();
+};
+
+const invalidate = (accountId) => {
+    cache.delete(Number(accountId));
+};
+
+module.exports = { lookup, post, invalidate, toCents };
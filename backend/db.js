@@ -1,12 +1,18 @@
 const mysql = require('mysql2/promise');
 
+const connectionLimit = parseInt(process.env.DB_CONNECTION_LIMIT, 10) || 10;
+
 const dbConfig = {
-    host: 'localhost',
-    user: 'root',
-    password: '',
-    database: 'pankkiautomaatti',
+    host: process.env.DB_HOST || 'localhost',
+    user: process.env.DB_USER || 'root',
+    password: process.env.DB_PASSWORD || '',
+    database: process.env.DB_NAME || 'pankkiautomaatti',
     waitForConnections: true,
-    connectionLimit: 10,
+    connectionLimit,
+    maxIdle: connectionLimit,
+    idleTimeout: 0,
+    enableKeepAlive: true,
+    keepAliveInitialDelay: 10000,
     queueLimit: 0
 };
 
@@ -31,5 +37,6 @@ module.exports = {
             throw error;
         }
     },
-    pool
+    pool,
+    connectionLimit
 };
\ No newline at end of file
@@ -0,0 +1,42 @@
+const metrics = require('./metrics');
+
+// Asiakas lähettää X-Request-Deadline-otsakkeessa ehdottoman aikarajan (ms epochista),
+// joka johdetaan istunnon jäljellä olevasta ajasta
+const parseDeadline = (req, res, next) => {
+    const header = req.headers['x-request-deadline'];
+    const deadline = header ? parseInt(header, 10) : NaN;
+    req.deadline = isNaN(deadline) ? null : deadline;
+    next();
+};
+
+const abandon = (res, stage) => {
+    metrics.increment('deadline_abandoned_total');
+    metrics.increment(`deadline_abandoned_${stage}`);
+    res.status(504).json({ error: 'Pyynnön aikaraja ylittyi' });
+};
+
+// Palauttaa true ja vastaa 504, jos asiakas on jo luovuttanut ennen vaihetta `stage`
+const deadlineExpired = (req, res, stage) => {
+    if (req.deadline === null || Date.now() < req.deadline) {
+        return false;
+    }
+    abandon(res, stage);
+    return true;
+};
+
+// Kyselyn aikaraja: pienempi varabudjetista ja asiakkaan jäljellä olevasta ajasta.
+// Jos aikaa ei ole jäljellä, vastaa 504 ja palauttaa null, jolloin kyselyä ei tehdä
+// (nollan aikarajalla kysely epäonnistuisi heti ja reitti vastaisi 500).
+const remainingMs = (req, res, stage, fallback) => {
+    if (req.deadline === null) {
+        return fallback;
+    }
+    const remaining = req.deadline - Date.now();
+    if (remaining <= 0) {
+        abandon(res, stage);
+        return null;
+    }
+    return Math.min(fallback, remaining);
+};
+
+module.exports = { parseDeadline, deadlineExpired, remainingMs };
@@ -0,0 +1,75 @@
+const db = require('./db');
+
+// /withdraw pitää transaktioyhteyden auki ja hakee mallien kautta samalla toisen yhteyden
+// poolista, joten pahimmillaan pyyntö varaa kaksi yhteyttä. Jos sisään päästetään enemmän
+// kuin puolet poolista, transaktiot voivat jäädä odottamaan toistensa yhteyksiä.
+const CONNECTIONS_PER_REQUEST = 2;
+const POOL_SIZE = db.connectionLimit;
+const MAX_IN_FLIGHT = parseInt(process.env.MAX_IN_FLIGHT, 10) || Math.max(1, Math.floor(POOL_SIZE / CONNECTIONS_PER_REQUEST));
+
+if (MAX_IN_FLIGHT * CONNECTIONS_PER_REQUEST > POOL_SIZE) {
+    console.warn(`MAX_IN_FLIGHT=${MAX_IN_FLIGHT} voi varata enemmän yhteyksiä kuin poolissa on (${POOL_SIZE})`);
+}
+
+let inFlight = 0;
+const queues = new Map();
+const rotation = [];
+
+// Vuoro annetaan yhteyden osoitteelle: todentamatonta X-ATM-Id-otsaketta vaihtamalla
+// yksi asiakas saisi useita vuoroja
+const atmKey = (req) => req.ip;
+
+const dispatchNext = () => {
+    while (inFlight < MAX_IN_FLIGHT && rotation.length > 0) {
+        const key = rotation.shift();
+        const queue = queues.get(key);
+        const next = queue.shift();
+
+        if (queue.length > 0) {
+            rotation.push(key);
+        } else {
+            queues.delete(key);
+        }
+
+        next();
+    }
+};
+
+const admit = (req, res, next) => {
+    inFlight++;
+    let released = false;
+    const release = () => {
+        if (released) return;
+        released = true;
+        inFlight--;
+        dispatchNext();
+    };
+    res.on('finish', release);
+    res.on('close', release);
+    next();
+};
+
+// Rajoittaa samanaikaiset pyynnöt niin, että niiden yhteydet mahtuvat tietokantapooliin, ja jakaa
+// vapautuvat paikat vuorotellen automaateille, jotta yksi kiireinen automaatti
+// ei varaa koko poolia muilta
+const fairQueue = (req, res, next) => {
+    if (inFlight < MAX_IN_FLIGHT && rotation.length === 0) {
+        return admit(req, res, next);
+    }
+
+    const key = atmKey(req);
+    let queue = queues.get(key);
+    if (!queue) {
+        queue = [];
+        queues.set(key, queue);
+        rotation.push(key);
+    }
+    queue.push(() => {
+        if (res.writableEnded || req.socket.destroyed) {
+            return;
+        }
+        admit(req, res, next);
+    });
+};
+
+module.exports = { fairQueue };
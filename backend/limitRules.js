@@ -0,0 +1,101 @@
+// Nostorajojen säännöt ilman tallennusta: kortti- ja tilikohtaiset päivälaskurit
+// (summa ja lukumäärä) sekä yksittäisen noston enimmäismäärä. Päivä vaihtuu laiskasti,
+// kun laskuria seuraavan kerran käytetään. limits.js käyttää tätä tallennuksen kanssa,
+// tools/stub_server.js omalla kellollaan, joten molemmat noudattavat samoja rajoja.
+
+const defaultLimits = () => ({
+    perTransaction: parseFloat(process.env.LIMIT_PER_TRANSACTION) || 1000,
+    dailyAmount: parseFloat(process.env.LIMIT_DAILY_AMOUNT) || 2000,
+    dailyCount: parseInt(process.env.LIMIT_DAILY_COUNT, 10) || 10
+});
+
+// Paikallisen ajan päivänumero, jotta raja nollautuu automaatin keskiyöllä
+const dayNumber = (now = new Date()) => Math.floor((now.getTime() - now.getTimezoneOffset() * 60000) / 86400000);
+
+const cardKey = (card) => `c:${card}`;
+const accountKey = (account) => `a:${account}`;
+
+class LimitLedger {
+    constructor({ limits = defaultLimits(), now = () => new Date() } = {}) {
+        this.limits = limits;
+        this.now = now;
+        // Avain -> [päivänumero, summa, lukumäärä]
+        this.entries = new Map();
+        this.dirty = false;
+    }
+
+    today() {
+        return dayNumber(this.now());
+    }
+
+    entryFor(key, today) {
+        let entry = this.entries.get(key);
+        if (!entry) {
+            entry = new Float64Array(3);
+            entry[0] = today;
+            this.entries.set(key, entry);
+        } else if (entry[0] !== today) {
+            entry[0] = today;
+            entry[1] = 0;
+            entry[2] = 0;
+        }
+        return entry;
+    }
+
+    usage(key, today) {
+        const entry = this.entries.get(key);
+        return entry && entry[0] === today ? { amount: entry[1], count: entry[2] } : { amount: 0, count: 0 };
+    }
+
+    // Jäljellä oleva raja: pienempi kortin ja tilin jäljellä olevista
+    remaining(card, account) {
+        const today = this.today();
+        const cardUsage = this.usage(cardKey(card), today);
+        const accountUsage = this.usage(accountKey(account), today);
+        const dailyAmount = Math.max(0, this.limits.dailyAmount - Math.max(cardUsage.amount, accountUsage.amount));
+        return {
+            per_transaction: Math.min(this.limits.perTransaction, dailyAmount),
+            daily_amount: dailyAmount,
+            daily_count: Math.max(0, this.limits.dailyCount - Math.max(cardUsage.count, accountUsage.count))
+        };
+    }
+
+    // Varaa noston rajoista heti tarkistuksen yhteydessä, jotta samanaikaiset nostot
+    // eivät ylitä rajaa. Palauttaa virheilmoituksen, jos jokin raja ylittyy, muuten null.
+    reserve(card, account, amount) {
+        if (amount > this.limits.perTransaction) {
+            return `Yksittaisen noston raja on ${this.limits.perTransaction} euroa`;
+        }
+        const left = this.remaining(card, account);
+        if (left.daily_count <= 0) {
+            return 'Paivan nostojen enimmaismaara on taynna';
+        }
+        if (amount > left.daily_amount) {
+            return `Paivaraja ylittyy: jaljella ${left.daily_amount} euroa`;
+        }
+
+        const today = this.today();
+        for (const key of [cardKey(card), accountKey(account)]) {
+            const entry = this.entryFor(key, today);
+            entry[1] += amount;
+            entry[2] += 1;
+        }
+        this.dirty = true;
+        return null;
+    }
+
+    // Peruu varauksen, jos nosto epäonnistui varauksen jälkeen
+    release(card, account, amount) {
+        const today = this.today();
+        for (const key of [cardKey(card), accountKey(account)]) {
+            const entry = this.entries.get(key);
+            if (entry && entry[0] === today) {
+                entry[1] = Math.max(0, entry[1] - amount);
+                entry[2] = Math.max(0, entry[2] - 1);
+            }
+        }
+        this.dirty = true;
+    }
+}
+
+module.exports = { LimitLedger, defaultLimits, dayNumber };
@@ -0,0 +1,63 @@
+// Nostorajat: säännöt ja laskurit ovat limitRules.js:ssä, tämä moduuli pitää prosessin
+// yhteisen laskurin ja tallentaa sen levylle määrävälein.
+
+const fs = require('fs');
+const { LimitLedger } = require('./limitRules');
+
+const ledger = new LimitLedger();
+const limits = ledger.limits;
+
+const CHECKPOINT_FILE = process.env.LIMITS_CHECKPOINT_FILE || 'limits-checkpoint.json';
+const CHECKPOINT_INTERVAL_MS = parseInt(process.env.LIMITS_CHECKPOINT_INTERVAL_MS, 10) || 30000;
+
+const remaining = (card, account) => ledger.remaining(card, account);
+const reserve = (card, account, amount) => ledger.reserve(card, account, amount);
+const release = (card, account, amount) => ledger.release(card, account, amount);
+
+// Kirjoittaa vain tämän päivän laskurit väliaikaiseen tiedostoon ja vaihtaa sen paikalleen
+const checkpoint = () => {
+    if (!ledger.dirty) return;
+    const today = ledger.today();
+    const entries = [];
+    for (const [key, entry] of ledger.entries) {
+        if (entry[0] === today) {
+            entries.push([key, entry[1], entry[2]]);
+        } else {
+            ledger.entries.delete(key);
+        }
+    }
+    const temporary = `${CHECKPOINT_FILE}.tmp`;
+    try {
+        fs.writeFileSync(temporary, JSON.stringify({ day: today, entries }));
+        fs.renameSync(temporary, CHECKPOINT_FILE);
+        ledger.dirty = false;
+    } catch (error) {
+        console.error('Nostorajojen tallennus epaonnistui:', error.message);
+    }
+};
+
+const restore = () => {
+    try {
+        const saved = JSON.parse(fs.readFileSync(CHECKPOINT_FILE, 'utf8'));
+        if (saved.day !== ledger.today()) return;
+        for (const [key, amount, count] of saved.entries) {
+            const entry = new Float64Array(3);
+            entry[0] = saved.day;
+            entry[1] = amount;
+            entry[2] = count;
+            ledger.entries.set(key, entry);
+        }
+    } catch (error) {
+        if (error.code !== 'ENOENT') {
+            console.error('Nostorajojen lataus epaonnistui:', error.message);
+        }
+    }
+};
+
+restore();
+setInterval(checkpoint, CHECKPOINT_INTERVAL_MS).unref();
+// Signaalien käsittely ja hallittu sammutus ovat app.js:ssä, joka kutsuu checkpointia
+// vasta, kun käynnissä olevat pyynnöt ovat valmistuneet
+process.once('beforeExit', checkpoint);
+
+module.exports = { reserve, release, remaining, checkpoint, limits };
@@ -0,0 +1,9 @@
+const counters = {};
+
+const increment = (name, by = 1) => {
+    counters[name] = (counters[name] || 0) + by;
+};
+
+const snapshot = () => Object.assign({}, counters);
+
+module.exports = { increment, snapshot };
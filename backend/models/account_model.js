@@ -66,12 +66,15 @@ module.exports = {
         });
     },
 
-    update: (accountId, updates) => {
+    update: (accountId, updates, connection = null) => {
         return new Promise(async (resolve, reject) => {
-            let connection;
+            let localConnection = null;
             try {
-                connection = await db.getConnection();
-                console.log('Acquired connection for accounts.update');
+                if (!connection) {
+                    localConnection = await db.getConnection();
+                    console.log('Acquired connection for accounts.update');
+                    connection = localConnection;
+                }
                 const result = await connection.query('UPDATE accounts SET ? WHERE account_id = ?', [updates, accountId]);
                 console.log('Update result:', result);
                 resolve(result);
@@ -79,8 +82,46 @@ module.exports = {
                 console.error('Error in accounts.update:', error.message);
                 reject(error);
             } finally {
-                if (connection) connection.release();
-                console.log('Released connection for accounts.update');
+                if (localConnection) {
+                    localConnection.release();
+                    console.log('Released connection for accounts.update');
+                }
+            }
+        });
+    },
+
+    // Suhteellinen saldomuutos: ei ylikirjoita samanaikaisia muutoksia. Jos minimumBalance
+    // on annettu, päivitys tehdään vain, kun saldo on vähintään sen verran (affectedRows 0 muuten).
+    adjustBalance: (accountId, delta, minimumBalance = null, connection = null) => {
+        return new Promise(async (resolve, reject) => {
+            let localConnection = null;
+            try {
+                if (!connection) {
+                    localConnection = await db.getConnection();
+                    connection = localConnection;
+                }
+                const [result] = minimumBalance === null
+                    ? await connection.query('UPDATE accounts SET balance = balance + ? WHERE account_id = ?', [delta, accountId])
+                    : await connection.query('UPDATE accounts SET balance = balance + ? WHERE account_id = ? AND balance >= ?', [delta, accountId, minimumBalance]);
+                resolve(result);
+            } catch (error) {
+                console.error('Error in accounts.adjustBalance:', error.message);
+                reject(error);
+            } finally {
+                if (localConnection) localConnection.release();
+            }
+        });
+    },
+
+    // Saldo annetun yhteyden kautta, jotta saman transaktion päivitys näkyy luettaessa
+    getBalance: (accountId, connection) => {
+        return new Promise(async (resolve, reject) => {
+            try {
+                const [results] = await connection.query('SELECT balance FROM accounts WHERE account_id = ?', [accountId]);
+                resolve(results.length > 0 ? results[0].balance : null);
+            } catch (error) {
+                console.error('Error in accounts.getBalance:', error.message);
+                reject(error);
             }
         });
     },
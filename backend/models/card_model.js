@@ -20,7 +20,7 @@ module.exports = {
         });
     },
 
-    getOne: (cardNumber) => {
+    getOne: (cardNumber, timeoutMs = 10000) => {
         return new Promise((resolve, reject) => {
             let connection;
             let timeout; 
@@ -32,14 +32,14 @@ module.exports = {
                         const error = new Error('Database query timed out');
                         console.error(error.message);
                         reject(error);
-                    }, 10000);
+                    }, timeoutMs);
     
                     console.log('Executing query: SELECT * FROM cards WHERE card_number = ?', cardNumber);
                     return connection.query('SELECT * FROM cards WHERE card_number = ?', [cardNumber]);
                 })
                 .then(([results]) => {
                     clearTimeout(timeout);
-                    console.log('Query result:', results);
+                    console.log('cards.getOne rows:', results.length);
                     resolve(results.length > 0 ? results[0] : null);
                 })
                 .catch(error => {
@@ -62,7 +62,7 @@ module.exports = {
                 connection = await db.getConnection();
                 console.log('Acquired connection for cards.getAll');
                 const [results] = await connection.query('SELECT * FROM cards');
-                console.log('Query result:', results);
+                console.log('cards.getAll rows:', results.length);
                 resolve(results);
             } catch (error) {
                 console.error('Error in cards.getAll:', error.message);
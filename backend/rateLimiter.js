@@ -0,0 +1,84 @@
+const metrics = require('./metrics');
+
+// Token bucket -rajoitin kiinteän kokoisessa avoimen osoituksen taulussa: ämpärit ovat
+// typed arrayssa eivätkä erillisinä olioina, joten muisti ei kasva avainten määrän mukana.
+// Täyttö lasketaan laiskasti vasta kun avainta käytetään. Vain tyhjä paikka alkaa täydestä
+// ämpäristä; törmäyksessä uusi avain jatkaa paikan nykyisestä ämpäristä, jolloin se voi
+// joutua odottamaan toisen avaimen takia, mutta avainta vaihtamalla ei saa uutta pursketta.
+class TokenBuckets {
+    constructor({ ratePerMinute, burst, slots = 65536 }) {
+        this.ratePerMs = ratePerMinute / 60000;
+        this.burst = burst;
+        this.mask = slots - 1;
+        this.keys = new Uint32Array(slots);
+        this.tokens = new Float64Array(slots);
+        this.updated = new Float64Array(slots);
+    }
+
+    // FNV-1a; 0 on varattu tyhjälle paikalle
+    static hash(key) {
+        let hash = 0x811c9dc5;
+        for (let i = 0; i < key.length; i++) {
+            hash ^= key.charCodeAt(i);
+            hash = Math.imul(hash, 0x01000193);
+        }
+        return (hash >>> 0) || 1;
+    }
+
+    // Palauttaa 0, jos pyyntö sallitaan, muuten millisekunnit seuraavaan tokeniin
+    take(key, now = Date.now()) {
+        const hash = TokenBuckets.hash(key);
+        const slot = hash & this.mask;
+        if (this.keys[slot] === 0) {
+            this.keys[slot] = hash;
+            this.tokens[slot] = this.burst;
+            this.updated[slot] = now;
+        } else {
+            this.keys[slot] = hash;
+            const refill = (now - this.updated[slot]) * this.ratePerMs;
+            this.tokens[slot] = Math.min(this.burst, this.tokens[slot] + refill);
+            this.updated[slot] = now;
+        }
+
+        if (this.tokens[slot] >= 1) {
+            this.tokens[slot] -= 1;
+            return 0;
+        }
+        return Math.ceil((1 - this.tokens[slot]) / this.ratePerMs);
+    }
+}
+
+const cardBuckets = new TokenBuckets({
+    ratePerMinute: parseFloat(process.env.RATE_LIMIT_CARD_PER_MINUTE) || 20,
+    burst: parseFloat(process.env.RATE_LIMIT_CARD_BURST) || 10
+});
+const atmBuckets = new TokenBuckets({
+    ratePerMinute: parseFloat(process.env.RATE_LIMIT_ATM_PER_MINUTE) || 120,
+    burst: parseFloat(process.env.RATE_LIMIT_ATM_BURST) || 30
+});
+
+const reject = (res, waitMs, counter) => {
+    metrics.increment(counter);
+    metrics.increment('rate_limited_total');
+    res.set('Retry-After', String(Math.ceil(waitMs / 1000)));
+    return res.status(429).json({ error: 'Liian monta yritysta, yrita hetken kuluttua uudelleen' });
+};
+
+// Rajoittaa tunnistautumisyritykset ennen bcrypt-vertailua ja tietokantaa: ensin automaatti,
+// sitten kortti. Automaatti tunnistetaan yhteyden osoitteesta, koska X-ATM-Id on
+// todentamaton otsake ja sen vaihtaminen antaisi jokaiselle pyynnölle oman ämpärin.
+// Saman isännän päätteet (ATM_READERS) jakavat ämpärin; RATE_LIMIT_ATM_* mitoitetaan sen mukaan.
+const limitAuth = (req, res, next) => {
+    const now = Date.now();
+    const atmWait = atmBuckets.take(req.ip, now);
+    if (atmWait > 0) return reject(res, atmWait, 'rate_limited_atm');
+
+    const cardNumber = req.body && req.body.card_number;
+    if (cardNumber) {
+        const cardWait = cardBuckets.take(String(cardNumber), now);
+        if (cardWait > 0) return reject(res, cardWait, 'rate_limited_card');
+    }
+    next();
+};
+
+module.exports = { limitAuth, TokenBuckets };
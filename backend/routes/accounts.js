@@ -1,5 +1,6 @@
 var express = require('express');
 const accountsModel = require('../models/account_model');
+const availableFunds = require('../availableFunds');
 var router = express.Router();
 const { verifyToken } = require('../verifyToken');
 
@@ -50,6 +51,7 @@ router.put('/:accountId', verifyToken, async (req, res) => {
 
     try {
         const result = await accountsModel.update(accountId, updatedAccount);
+        availableFunds.invalidate(accountId);
         if (result.affectedRows === 0) {
             return res.status(404).json({ error: 'Tiliä ei löydy' });
         }
@@ -65,6 +67,7 @@ router.delete('/:accountId', verifyToken, async (req, res) => {
 
     try {
         const result = await accountsModel.delete(accountId);
+        availableFunds.invalidate(accountId);
         if (result.affectedRows === 0) {
             return res.status(404).json({ error: 'Tiliä ei löydy' });
         }
@@ -7,6 +7,7 @@ var bcrypt = require('bcrypt');
 var jwt = require('jsonwebtoken');
 var db = require('../db');
 const { verifyToken } = require('../verifyToken')
+const { deadlineExpired, remainingMs } = require('../deadline');
 
 var router = express.Router();
 const saltRounds = 10;
@@ -20,9 +21,13 @@ router.post('/auth', async (req, res) => {
         return res.status(400).json({ error: 'card_number and pin_code are required' });
     }
 
+    if (deadlineExpired(req, res, 'queue')) return;
+
     try {
         console.log('Fetching card for card_number:', card_number);
-        const card = await cardsModel.getOne(card_number);
+        const budgetMs = remainingMs(req, res, 'db', 10000);
+        if (budgetMs === null) return;
+        const card = await cardsModel.getOne(card_number, budgetMs);
         if (!card) {
             console.log('Card not found');
             return res.status(404).json({ error: 'Korttia ei löydy' });
@@ -34,6 +39,8 @@ router.post('/auth', async (req, res) => {
             return res.status(403).json({ error: 'Kortti on estetty' });
         }
 
+        if (deadlineExpired(req, res, 'pin_verify')) return;
+
         console.log('Verifying PIN...');
         const pinMatch = await bcrypt.compare(pin_code, card.pin_hash);
         if (!pinMatch) {
@@ -62,6 +69,8 @@ router.post('/auth', async (req, res) => {
         }
 
 
+        if (deadlineExpired(req, res, 'db')) return;
+
         console.log('PIN correct, resetting failed_pin_attempts and is_blocked...');
         await cardsModel.update(card_number, {
             failed_pin_attempts: 0,
@@ -108,6 +117,7 @@ router.post('/auth', async (req, res) => {
         });
     } catch (error) {
         console.error('Error in /cards/auth:', error.message);
+        if (deadlineExpired(req, res, 'db')) return;
         res.status(500).json({ error: 'Sisäinen palvelinvirhe' });
     }
 });
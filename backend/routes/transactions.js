@@ -5,12 +5,17 @@ const transactionsModel = require('../models/transactions_model');
 const cardsModel = require('../models/card_model');
 var router = express.Router();
 const { verifyToken } = require('../verifyToken');
+const { deadlineExpired, remainingMs } = require('../deadline');
 const db = require('../db');
+const velocity = require('../velocity');
+const limits = require('../limits');
+const availableFunds = require('../availableFunds');
+const metrics = require('../metrics');
+const withdrawals = require('../withdrawals');
 
 router.post('/withdraw', verifyToken, async (req, res) => {
-    const { card_number, pin_code, amount } = req.body;
-
-    console.log('Request body:', req.body);
+    // reference: asiakkaan nostokohtainen viite, jolla nosto voidaan perua (reverse_withdrawal)
+    const { card_number, pin_code, amount, reference } = req.body;
 
     if (!card_number || !pin_code || !amount) {
         return res.status(400).json({ error: 'card_number, pin_code, and amount are required' });
@@ -22,16 +27,24 @@ router.post('/withdraw', verifyToken, async (req, res) => {
         return res.status(400).json({ error: 'Amount must be a positive number' });
     }
 
+    if (deadlineExpired(req, res, 'queue')) return;
+
     let connection;
+    let reservedAccount = null;
+    let reservedVelocity = null;
+    let pendingReference = null;
 
     try {
         connection = await db.getConnection();
         await connection.beginTransaction();
 
 
-        const card = await cardsModel.getOne(card_number);
-
-        console.log('Card:', card);
+        const budgetMs = remainingMs(req, res, 'db', 10000);
+        if (budgetMs === null) {
+            await connection.rollback();
+            return;
+        }
+        const card = await cardsModel.getOne(card_number, budgetMs);
 
         if (!card) {
             await connection.rollback();
@@ -44,6 +57,11 @@ router.post('/withdraw', verifyToken, async (req, res) => {
             return res.status(403).json({ error: 'Kortti on estetty' });
         }
 
+        if (deadlineExpired(req, res, 'pin_verify')) {
+            await connection.rollback();
+            return;
+        }
+
         const storedPinHash = card.pin_hash;
         const pinMatch = await bcrypt.compare(pin_code, storedPinHash);
 
@@ -77,89 +95,231 @@ router.post('/withdraw', verifyToken, async (req, res) => {
             });
         }
 
+        // Nopeustarkistus muistissa ennen saldokyselyä; sallittu nosto kirjataan heti,
+        // jotta samanaikaiset nostot näkevät toisensa, ja perutaan finallyssa, jos nosto ei toteudu
+        const velocityEvent = {
+            card: card_number,
+            account: card.account_id,
+            amount: withdrawalAmount,
+            atm: req.headers['x-atm-id'] || req.ip
+        };
+        const risk = velocity.reserve(velocityEvent);
+        metrics.increment('velocity_checks');
+        if (risk.decision === 'deny') {
+            metrics.increment('velocity_denied');
+            console.log('Velocity check denied withdrawal:', risk.reasons.join(','));
+            await connection.rollback();
+            return res.status(403).json({ error: 'Nosto hylatty: poikkeuksellinen kayttomaara' });
+        }
+        reservedVelocity = velocityEvent;
 
-        const account = await accountsModel.getOne(card.account_id);
+        if (deadlineExpired(req, res, 'db')) {
+            await connection.rollback();
+            return;
+        }
 
-        console.log('Account:', account);
+        // Saldo ja nostettavissa oleva määrä välimuistista; haetaan kannasta vain ensimmäisellä kerralla
+        if (card.card_type === 'credit' && (card.credit_limit === null || card.credit_limit === undefined)) {
+            await connection.rollback();
+            return res.status(400).json({ error: 'Credit card must have a defined credit limit' });
+        }
 
-        if (!account || !account.length) {
+        const funds = await availableFunds.lookup(card);
+        if (!funds) {
             await connection.rollback();
             return res.status(404).json({ error: 'Account not found' });
         }
 
-        const rawBalance = account[0].balance;
-        const currentBalance = parseFloat(rawBalance);
-
-        console.log('Raw balance from DB:', rawBalance);
-        console.log('Parsed currentBalance:', currentBalance);
-        console.log('Withdrawal amount:', withdrawalAmount);
-
-        if (isNaN(currentBalance)) {
-            console.log('Balance is not a valid number:', rawBalance);
+        const withdrawalCents = availableFunds.toCents(withdrawalAmount);
+        if (withdrawalCents > funds.availableCents) {
+            console.log('Insufficient funds - Available:', funds.availableCents / 100, 'Withdrawal amount:', withdrawalAmount);
             await connection.rollback();
-            return res.status(500).json({ error: 'Invalid balance in database' });
+            return res.status(400).json({ error: card.card_type === 'credit' ? 'Riittamattomat varat: Luottoraja ylitetty' : 'Riittamattomat varat' });
         }
 
-        if (card.card_type === 'credit') {
-
-            if (card.credit_limit === null || card.credit_limit === undefined) {
-                await connection.rollback();
-                return res.status(400).json({ error: 'Credit card must have a defined credit limit' });
-            }
-
-            const creditLimit = parseFloat(card.credit_limit);
-            const usedCredit = currentBalance < 0 ? Math.abs(currentBalance) : 0;
-            const availableCredit = creditLimit - usedCredit;
-
-            console.log('Credit limit:', creditLimit, 'Used credit:', usedCredit, 'Available credit:', availableCredit);
-
-            if (withdrawalAmount > availableCredit) {
-                await connection.rollback();
-                return res.status(400).json({ error: 'Riittamattomat varat: Luottoraja ylitetty' });
-            }
-        } else {
+        // Päivä- ja nostokohtaiset rajat varataan vasta kaikkien muiden tarkistusten jälkeen
+        const limitError = limits.reserve(card_number, card.account_id, withdrawalAmount);
+        if (limitError) {
+            await connection.rollback();
+            return res.status(403).json({ error: limitError });
+        }
+        reservedAccount = card.account_id;
 
-            if (currentBalance < withdrawalAmount) {
-                console.log('Insufficient funds - Current balance:', currentBalance, 'Withdrawal amount:', withdrawalAmount);
+        // Viite varataan ennen veloitusta; jos asiakas on jo perunut sen, nostoa ei tehdä
+        if (reference) {
+            if (!withdrawals.begin(String(reference), card.account_id, card_number, withdrawalAmount, velocityEvent)) {
+                limits.release(card_number, card.account_id, withdrawalAmount);
+                reservedAccount = null;
                 await connection.rollback();
-                return res.status(400).json({ error: 'Riittamattomat varat' });
+                return res.status(409).json({ error: 'Nosto on jo kasitelty tai peruttu' });
             }
+            pendingReference = String(reference);
         }
 
-        const newBalance = currentBalance - withdrawalAmount;
-
-        await accountsModel.update(card.account_id, {
-            balance: newBalance.toFixed(2)
-        });
+        // Suhteellinen päivitys ehdolla, joka hylkää noston, jos välimuistin saldo oli vanhentunut
+        const minimumCents = funds.creditLimitCents === null ? withdrawalCents : withdrawalCents - funds.creditLimitCents;
+        const adjusted = await accountsModel.adjustBalance(card.account_id, (-withdrawalCents / 100).toFixed(2), (minimumCents / 100).toFixed(2), connection);
+        if (adjusted.affectedRows === 0) {
+            limits.release(card_number, card.account_id, withdrawalAmount);
+            reservedAccount = null;
+            availableFunds.invalidate(card.account_id);
+            await connection.rollback();
+            return res.status(400).json({ error: 'Riittamattomat varat' });
+        }
+        // Uusi saldo luetaan samassa transaktiossa: välimuistin saldo voi olla vanhentunut
+        const balanceCents = availableFunds.toCents(await accountsModel.getBalance(card.account_id, connection));
 
-        await transactionsModel.create({
+        const created = await transactionsModel.create({
             transaction_time: new Date(),
             summa: -withdrawalAmount,
             account_id: card.account_id
         }, connection);
 
+        // Viimeinen tarkistus juuri ennen commitia: jos asiakas on jo luovuttanut,
+        // nosto perutaan kokonaan eikä jää kirjatuksi ilman annettuja seteleitä
+        if (deadlineExpired(req, res, 'commit')) {
+            limits.release(card_number, card.account_id, withdrawalAmount);
+            reservedAccount = null;
+            await connection.rollback();
+            return;
+        }
+        // Peruutus on voinut mitätöidä viitteen kesken noston
+        if (pendingReference && !withdrawals.beginCommit(pendingReference)) {
+            limits.release(card_number, card.account_id, withdrawalAmount);
+            reservedAccount = null;
+            await connection.rollback();
+            return res.status(409).json({ error: 'Nosto on peruttu' });
+        }
+
         await connection.commit();
+        if (pendingReference) {
+            withdrawals.committed(pendingReference, created.insertId);
+            pendingReference = null;
+        }
+        const newBalance = balanceCents / 100;
+        availableFunds.post(card.account_id, balanceCents);
+        reservedVelocity = null;
 
         res.status(200).json({
             message: 'Withdrawal successful',
             transaction: {
+                transaction_id: created.insertId,
                 amount: withdrawalAmount,
                 new_balance: newBalance
             }
         });
-
-        connection.release();
     } catch (error) {
         console.error('Virhe:', error);
+        if (reservedAccount !== null) {
+            limits.release(card_number, reservedAccount, withdrawalAmount);
+        }
+        if (connection) {
+            try {
+                await connection.rollback();
+            } catch (rollbackError) {
+                console.error('Peruutusvirhe:', rollbackError);
+            }
+        }
+        // Aikarajaan katkennut kysely on asiakkaan luovuttama pyyntö, ei palvelinvirhe
+        if (deadlineExpired(req, res, 'db')) return;
+        res.status(500).json({ error: 'Sisainen palvelinvirhe' });
+    } finally {
+        if (pendingReference) withdrawals.abandon(pendingReference);
+        if (reservedVelocity) velocity.release(reservedVelocity);
+        if (connection) connection.release();
+    }
+});
+
+// Kirjatun noston peruutus viitteen mukaan, kun automaatti ei saanut seteleitä annettua tai
+// ei tiedä, kirjattiinko nosto (aikaraja). Idempotentti: toistettu pyyntö palauttaa saman
+// tuloksen eikä hyvitä tiliä uudelleen. Peruutus palauttaa summan tilille vastakirjauksella
+// ja vapauttaa noston nostorajoista ja nopeusseurannasta.
+router.post('/reverse_withdrawal', verifyToken, async (req, res) => {
+    const { reference } = req.body;
+    if (!reference) {
+        return res.status(400).json({ error: 'reference is required' });
+    }
+
+    const claim = withdrawals.claimReversal(String(reference), req.user.account_id);
+    if (claim.status === 'forbidden') {
+        return res.status(403).json({ error: 'Nosto ei kuulu tilille' });
+    }
+    if (claim.status === 'busy') {
+        return res.status(409).json({ error: 'Nosto tai peruutus on kesken, yrita uudelleen' });
+    }
+    if (claim.status === 'void') {
+        return res.status(200).json({ reversed: false, message: 'Nostoa ei kirjattu' });
+    }
+    const entry = claim.entry;
+    if (claim.status === 'reversed') {
+        return res.status(200).json({ reversed: true, original_transaction_id: entry.transactionId, transaction_id: entry.reversalId });
+    }
+
+    let connection;
+    try {
+        connection = await db.getConnection();
+        await connection.beginTransaction();
+
+        const amountCents = availableFunds.toCents(entry.amount);
+        await accountsModel.adjustBalance(entry.account, (amountCents / 100).toFixed(2), null, connection);
+        const balanceCents = availableFunds.toCents(await accountsModel.getBalance(entry.account, connection));
+        const created = await transactionsModel.create({
+            transaction_time: new Date(),
+            summa: entry.amount,
+            account_id: entry.account
+        }, connection);
+        await connection.commit();
+
+        const velocityEvent = entry.velocity;
+        withdrawals.reversed(String(reference), created.insertId);
+        limits.release(entry.card, entry.account, entry.amount);
+        if (velocityEvent) velocity.release(velocityEvent);
+        availableFunds.post(entry.account, balanceCents);
+        metrics.increment('withdrawals_reversed');
+        console.log('Nosto peruttu:', entry.transactionId, '->', created.insertId);
+
+        res.status(200).json({ reversed: true, original_transaction_id: entry.transactionId, transaction_id: created.insertId });
+    } catch (error) {
+        console.error('Virhe noston peruutuksessa:', error);
+        withdrawals.reversalFailed(String(reference));
         if (connection) {
             try {
                 await connection.rollback();
             } catch (rollbackError) {
                 console.error('Peruutusvirhe:', rollbackError);
             }
-            connection.release();
         }
         res.status(500).json({ error: 'Sisainen palvelinvirhe' });
+    } finally {
+        if (connection) connection.release();
+    }
+});
+
+// Jäljellä olevat nostorajat istunnon alussa (tili tokenista, kortti rungosta)
+// Kortin on kuuluttava tokenin tilille, muuten kenen tahansa kortin käyttö näkyisi
+router.post('/limits', verifyToken, async (req, res) => {
+    const { card_number } = req.body;
+    if (!card_number) {
+        return res.status(400).json({ error: 'card_number is required' });
+    }
+
+    if (deadlineExpired(req, res, 'queue')) return;
+
+    try {
+        const budgetMs = remainingMs(req, res, 'db', 10000);
+        if (budgetMs === null) return;
+        const card = await cardsModel.getOne(card_number, budgetMs);
+        if (!card) {
+            return res.status(404).json({ error: 'Card not found' });
+        }
+        if (Number(card.account_id) !== Number(req.user.account_id)) {
+            return res.status(403).json({ error: 'Kortti ei kuulu tilille' });
+        }
+        res.status(200).json(limits.remaining(card_number, card.account_id));
+    } catch (error) {
+        console.error('Virhe:', error);
+        if (deadlineExpired(req, res, 'db')) return;
+        res.status(500).json({ error: 'Sisainen palvelinvirhe' });
     }
 });
 
@@ -167,33 +327,39 @@ router.post('/withdraw', verifyToken, async (req, res) => {
 router.post('/balance', verifyToken, async (req, res) => {
     const { card_number, pin_code } = req.body;
 
-    console.log('Request body:', req.body);
-
     if (!card_number || !pin_code) {
         return res.status(400).json({ error: 'card_number and pin_code are required' });
     }
 
+    if (deadlineExpired(req, res, 'queue')) return;
+
     try {
-        const card = await cardsModel.getOne(card_number);
-        console.log('Card fetched:', card);
+        const budgetMs = remainingMs(req, res, 'db', 10000);
+        if (budgetMs === null) return;
+        const card = await cardsModel.getOne(card_number, budgetMs);
 
         if (!card) {
             console.log('No card found for card_number:', card_number);
             return res.status(404).json({ error: 'Card not found' });
         }
 
-        const account = await accountsModel.getOne(card.account_id);
-        if (!Array.isArray(account) || account.length === 0) {
+        if (deadlineExpired(req, res, 'db')) return;
+
+        const funds = await availableFunds.lookup(card);
+        if (!funds) {
             console.log('No account found for account_id:', card.account_id);
             return res.status(404).json({ error: 'Account not found' });
         }
 
         res.status(200).json({
             message: 'Balance retrieved successfully',
-            balance: parseFloat(account[0].balance)
+            balance: funds.balanceCents / 100,
+            available: funds.availableCents / 100,
+            card_type: card.card_type
         });
     } catch (error) {
         console.error('Virhe:', error);
+        if (deadlineExpired(req, res, 'db')) return;
         res.status(500).json({ error: 'Sisäinen palvelinvirhe' });
     }
 });
@@ -207,6 +373,8 @@ router.post('/get_transactions', async (req, res) => {
         return res.status(400).json({ error: 'account_id is required' });
     }
 
+    if (deadlineExpired(req, res, 'queue')) return;
+
     try {
         console.log('Fetching last 10 transactions for account_id:', account_id);
         const transactions = await transactionsModel.getByAccountId(account_id);
@@ -242,6 +410,8 @@ router.post('/top_up', async (req, res) => {
         return res.status(400).json({ error: 'account_id and a positive amount are required' });
     }
 
+    if (deadlineExpired(req, res, 'queue')) return;
+
     try {
 
         connection = await db.getConnection();
@@ -257,10 +427,10 @@ router.post('/top_up', async (req, res) => {
         }
 
 
-        const newBalance = parseFloat(account[0].balance) + parseFloat(amount);
-        console.log('Updating account balance to:', newBalance);
-
-        await accountsModel.update(account_id, { balance: newBalance.toFixed(2) });
+        const topUpCents = availableFunds.toCents(amount);
+        await accountsModel.adjustBalance(account_id, (topUpCents / 100).toFixed(2), null, connection);
+        const balanceCents = availableFunds.toCents(await accountsModel.getBalance(account_id, connection));
+        const newBalance = balanceCents / 100;
 
 
         const transactionData = {
@@ -274,6 +444,7 @@ router.post('/top_up', async (req, res) => {
 
 
         await connection.commit();
+        availableFunds.post(account_id, balanceCents);
 
         console.log('Top-up successful, new balance:', newBalance);
         res.status(200).json({ success: true, newBalance });
@@ -285,9 +456,10 @@ router.post('/top_up', async (req, res) => {
             } catch (rollbackError) {
                 console.error('Rollback error:', rollbackError);
             }
-            connection.release();
         }
         res.status(500).json({ error: 'Sisäinen palvelinvirhe' });
+    } finally {
+        if (connection) connection.release();
     }
 });
 
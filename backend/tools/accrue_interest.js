@@ -0,0 +1,284 @@
+#!/usr/bin/env node
+// Luottokorttitilien päivittäinen korko- ja ylitysmaksuajo. Negatiiviset saldot haetaan
+// rinnakkain usealla yhteydellä, korko lasketaan sentteinä kokonaisluvuilla (BigInt,
+// todellinen/365) ja kirjaukset tehdään yhdessä tietokantatransaktiossa isoina erinä.
+// Lukijoiden erät kirjataan avoimeen transaktioon heti, joten muistissa on kerrallaan
+// enintään yksi erä lukijaa kohden tilien määrästä riippumatta.
+// Ajo on idempotentti liiketoimintapäivää kohden: accrual_runs-taulun pääavain estää
+// saman päivän toisen ajon, ja merkintä kirjataan samassa transaktiossa kuin korot.
+//
+// Käyttö:
+//   node tools/accrue_interest.js --date 2025-03-20 --rate 0.1990 --overlimit-fee 5.00
+//   node tools/accrue_interest.js --bench 5000000      # laskenta ja erien muodostus ilman tietokantaa
+//   node tools/accrue_interest.js --bench 200000 --bench-db 1   # lisäksi kirjaus tietokantaan
+//
+// --bench-db kirjaa väliaikaisiin accounts- ja transactions-tauluihin, jotka peittävät
+// mittausyhteydellä oikeat taulut ja poistuvat yhteyden mukana (DB_HOST, DB_NAME kuten db.js).
+
+const os = require('os');
+
+const parseArgs = (argv) => {
+    const args = { date: null, rate: '0.1990', 'overlimit-fee': '0', batch: 5000, workers: Math.min(os.cpus().length, 8), bench: 0, 'bench-db': 0 };
+    for (let i = 0; i < argv.length; i += 2) {
+        const key = argv[i].replace(/^--/, '');
+        if (!(key in args)) {
+            console.error(`Tuntematon valitsin: ${argv[i]}`);
+            process.exit(1);
+        }
+        args[key] = typeof args[key] === 'number' ? Number(argv[i + 1]) : argv[i + 1];
+    }
+    if (!args.bench && !/^\d{4}-\d{2}-\d{2}$/.test(args.date || '')) {
+        console.error('--date muodossa YYYY-MM-DD on pakollinen');
+        process.exit(1);
+    }
+    return args;
+};
+
+// Desimaalimerkkijono kokonaisluvuksi annetulla desimaalimäärällä ilman liukulukuja
+const parseFixed = (text, decimals) => {
+    const match = /^(-?)(\d+)(?:\.(\d+))?$/.exec(String(text).trim());
+    if (!match) throw new Error(`Virheellinen luku: ${text}`);
+    const fraction = (match[3] || '').padEnd(decimals, '0');
+    if (fraction.length > decimals) throw new Error(`Liian monta desimaalia: ${text}`);
+    const value = BigInt(match[2] + fraction);
+    return match[1] ? -value : value;
+};
+
+const formatCents = (cents) => {
+    const negative = cents < 0n;
+    const magnitude = negative ? -cents : cents;
+    return `${negative ? '-' : ''}${magnitude / 100n}.${String(magnitude % 100n).padStart(2, '0')}`;
+};
+
+const RATE_DECIMALS = 6;
+const RATE_SCALE = 10n ** BigInt(RATE_DECIMALS);
+const DAYS_IN_YEAR = 365n;
+
+// Päivän korko sentteinä, pyöristys puolet ylöspäin: |saldo| * vuosikorko / 365
+const dailyInterest = (balanceCents, ratePpm) => {
+    if (balanceCents >= 0n) return 0n;
+    const numerator = -balanceCents * ratePpm;
+    const denominator = RATE_SCALE * DAYS_IN_YEAR;
+    return (numerator * 2n + denominator) / (denominator * 2n);
+};
+
+// Laskee yhden tilin kirjaukset: [korko, ylitysmaksu] sentteinä
+const accrue = (account, ratePpm, overlimitFee) => {
+    const balance = parseFixed(account.balance, 2);
+    const interest = dailyInterest(balance, ratePpm);
+    const limit = account.credit_limit === null ? null : parseFixed(account.credit_limit, 2);
+    const fee = limit !== null && -balance > limit ? overlimitFee : 0n;
+    return [interest, fee];
+};
+
+// Rinnakkainen luku: jokainen yhteys käy läpi oman osuutensa tileistä avainjärjestyksessä ja
+// antaa kunkin erän kirjoittajalle ennen seuraavaa hakua. Palauttaa tilien määrän ja summan.
+const scanAccounts = async (db, args, ratePpm, overlimitFee, write) => {
+    let accounts = 0;
+    let total = 0n;
+    const scanShard = async (shard) => {
+        let lastAccount = 0;
+        for (;;) {
+            const rows = await db.query(
+                `SELECT a.account_id, a.balance, MAX(c.credit_limit) AS credit_limit
+                 FROM accounts a JOIN cards c ON c.account_id = a.account_id
+                 WHERE c.card_type = 'credit' AND a.balance < 0 AND a.account_id > ? AND MOD(a.account_id, ?) = ?
+                 GROUP BY a.account_id, a.balance ORDER BY a.account_id LIMIT ?`,
+                [lastAccount, args.workers, shard, args.batch]
+            );
+            if (rows.length === 0) return;
+            const postings = [];
+            for (const row of rows) {
+                const [interest, fee] = accrue(row, ratePpm, overlimitFee);
+                if (interest > 0n || fee > 0n) postings.push({ account: row.account_id, interest, fee });
+            }
+            if (postings.length > 0) {
+                accounts += postings.length;
+                total = postings.reduce((sum, posting) => sum + posting.interest + posting.fee, total);
+                await write(postings);
+            }
+            lastAccount = rows[rows.length - 1].account_id;
+        }
+    };
+    // Kaikki lukijat ajetaan loppuun ennen virheen välittämistä, ettei yhteysallasta suljeta kesken hakujen
+    const results = await Promise.allSettled(Array.from({ length: args.workers }, (unused, shard) => scanShard(shard)));
+    const failed = results.find((result) => result.status === 'rejected');
+    if (failed) throw failed.reason;
+    return { accounts, total };
+};
+
+// Muodostaa yhden erän SQL-lauseet ja parametrit (jaettu varsinaisen ajon ja mittauksen kesken)
+const buildBatch = (batch, postedAt) => {
+    const transactionRows = [];
+    const cases = [];
+    const params = [];
+    const ids = [];
+    for (const posting of batch) {
+        if (posting.interest > 0n) transactionRows.push([postedAt, formatCents(-posting.interest), posting.account]);
+        if (posting.fee > 0n) transactionRows.push([postedAt, formatCents(-posting.fee), posting.account]);
+        cases.push('WHEN ? THEN ?');
+        params.push(posting.account, formatCents(posting.interest + posting.fee));
+        ids.push(posting.account);
+    }
+    return {
+        insert: ['INSERT INTO transactions (transaction_time, summa, account_id) VALUES ?', [transactionRows]],
+        update: [`UPDATE accounts SET balance = balance - CASE account_id ${cases.join(' ')} END WHERE account_id IN (?)`, [...params, ids]]
+    };
+};
+
+// Kirjoittaja avoimeen transaktioon: yhteys suorittaa yhden kyselyn kerrallaan, joten erät
+// ketjutetaan. Epäonnistunut erä hylkää myös kaikki sen jälkeen annetut.
+const createWriter = (connection, postedAt) => {
+    let tail = Promise.resolve();
+    return (postings) => {
+        const { insert, update } = buildBatch(postings, postedAt);
+        tail = tail.then(async () => {
+            await connection.query(...insert);
+            await connection.query(...update);
+        });
+        return tail;
+    };
+};
+
+// Avaa ajon transaktion ja varaa päivän. False, jos päivä on jo kirjattu.
+const beginRun = async (connection, args) => {
+    await connection.query(`CREATE TABLE IF NOT EXISTS accrual_runs (
+        business_date DATE PRIMARY KEY,
+        completed_at DATETIME NOT NULL,
+        accounts INT NOT NULL,
+        total DECIMAL(15, 2) NOT NULL
+    )`);
+
+    await connection.beginTransaction();
+    try {
+        // Pääavain tekee ajosta idempotentin: toinen ajo samalle päivälle kaatuu tähän.
+        // Määrät päivitetään ajon lopussa samassa transaktiossa.
+        await connection.query('INSERT INTO accrual_runs (business_date, completed_at, accounts, total) VALUES (?, NOW(), 0, 0)',
+            [args.date]);
+    } catch (error) {
+        await connection.rollback();
+        if (error.code === 'ER_DUP_ENTRY') {
+            console.log(`Päivän ${args.date} korot on jo kirjattu, ei tehdä mitään`);
+            return false;
+        }
+        throw error;
+    }
+    return true;
+};
+
+const run = async (args) => {
+    const db = require('../db');
+    const ratePpm = parseFixed(args.rate, RATE_DECIMALS);
+    const overlimitFee = parseFixed(args['overlimit-fee'], 2);
+    let connection = null;
+    try {
+        connection = await db.getConnection();
+        if (!(await beginRun(connection, args))) return;
+
+        const started = Date.now();
+        const write = createWriter(connection, new Date(`${args.date}T23:59:59`));
+        const { accounts, total } = await scanAccounts(db, args, ratePpm, overlimitFee, write);
+        await connection.query('UPDATE accrual_runs SET completed_at = NOW(), accounts = ?, total = ? WHERE business_date = ?',
+            [accounts, formatCents(total), args.date]);
+        await connection.commit();
+        console.log(`${accounts} tiliä, korot ja maksut yhteensä ${formatCents(total)}; kirjattu päivälle ${args.date} (${Date.now() - started} ms)`);
+    } catch (error) {
+        if (connection) await connection.rollback().catch(() => {});
+        throw error;
+    } finally {
+        if (connection) connection.release();
+        await db.pool.end();
+    }
+};
+
+// Kirjauksen mittaus: väliaikaiset taulut peittävät oikeat tällä yhteydellä, joten
+// buildBatchin lauseet ajetaan sellaisinaan eikä oikeisiin tauluihin kirjoiteta
+const benchPost = async (args, postings) => {
+    const db = require('../db');
+    const connection = await db.getConnection();
+    try {
+        await connection.query('CREATE TEMPORARY TABLE accounts (account_id INT PRIMARY KEY, balance DECIMAL(15, 2) NOT NULL)');
+        await connection.query(`CREATE TEMPORARY TABLE transactions (
+            transaction_id INT AUTO_INCREMENT PRIMARY KEY,
+            transaction_time DATETIME NOT NULL,
+            summa DECIMAL(15, 2) NOT NULL,
+            account_id INT NOT NULL
+        )`);
+        for (let start = 0; start < postings.length; start += args.batch) {
+            const rows = postings.slice(start, start + args.batch).map((posting) => [posting.account, '-500.00']);
+            await connection.query('INSERT INTO accounts (account_id, balance) VALUES ?', [rows]);
+        }
+
+        const started = process.hrtime.bigint();
+        await connection.beginTransaction();
+        const write = createWriter(connection, new Date());
+        for (let start = 0; start < postings.length; start += args.batch) {
+            await write(postings.slice(start, start + args.batch));
+        }
+        await connection.commit();
+        const seconds = Number(process.hrtime.bigint() - started) / 1e9;
+        const rate = postings.length / seconds;
+        console.log(`kirjaus ${postings.length} tiliä ${seconds.toFixed(2)} s: ${Math.round(rate)} tiliä/s; 5 000 000 tilin kirjausarvio ${(5000000 / rate).toFixed(1)} s`);
+    } finally {
+        connection.release();
+        await db.pool.end();
+    }
+};
+
+// Synteettinen mittaus: laskenta ja erien muodostus, --bench-db:llä myös kirjaus tietokantaan
+const bench = async (args) => {
+    const ratePpm = parseFixed(args.rate, RATE_DECIMALS);
+    const overlimitFee = parseFixed('5.00', 2);
+    const postedAt = new Date();
+    const started = process.hrtime.bigint();
+    const postings = args['bench-db'] ? [] : null;
+    let batch = [];
+    let total = 0n;
+    let statements = 0;
+
+    for (let i = 1; i <= args.bench; i++) {
+        const account = {
+            account_id: i,
+            balance: `-${(i * 7919) % 150000}.${String(i % 100).padStart(2, '0')}`,
+            credit_limit: '1000.00'
+        };
+        const [interest, fee] = accrue(account, ratePpm, overlimitFee);
+        total += interest + fee;
+        if (postings && (interest > 0n || fee > 0n)) postings.push({ account: i, interest, fee });
+        batch.push({ account: i, interest, fee });
+        if (batch.length === args.batch) {
+            buildBatch(batch, postedAt);
+            statements += 2;
+            batch = [];
+        }
+    }
+    if (batch.length > 0) {
+        buildBatch(batch, postedAt);
+        statements += 2;
+    }
+
+    const seconds = Number(process.hrtime.bigint() - started) / 1e9;
+    const rate = args.bench / seconds;
+    console.log(`${args.bench} tiliä ${seconds.toFixed(2)} s: ${Math.round(rate)} tiliä/s, ${statements} SQL-lausetta`);
+    console.log(`yhteensä ${formatCents(total)}; 5 000 000 tilin laskenta-arvio ${(5000000 / rate).toFixed(1)} s`);
+
+    if (postings) {
+        await benchPost(args, postings);
+    }
+};
+
+const main = async () => {
+    const args = parseArgs(process.argv.slice(2));
+    try {
+        if (args.bench) {
+            await bench(args);
+        } else {
+            await run(args);
+        }
+    } catch (error) {
+        console.error('Virhe:', error.message);
+        process.exit(1);
+    }
+};
+
+main();
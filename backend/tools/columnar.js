@@ -0,0 +1,115 @@
+// Yksinkertainen sarakepalamuoto tapahtumien analytiikkaa varten (ATMCOL1).
+//
+// Tiedosto:  "ATMCOL1\n" | rivilohko* | alatunniste (JSON) | alatunnisteen pituus (uint32 LE) | "ATMCOL1\n"
+// Rivilohko: jokainen sarake omana deflate-pakattuna palanaan (little-endian typed array)
+// Alatunniste kertoo jokaisen palan sijainnin sekä sarakkeen min/max-arvot, joten lukija
+// voi ohittaa kokonaisia lohkoja ja lukea vain tarvitsemansa sarakkeet. i64-sarakkeiden
+// min/max tallennetaan merkkijonoina, koska JSON ei tunne BigIntiä.
+
+const fs = require('fs');
+const zlib = require('zlib');
+
+const MAGIC = Buffer.from('ATMCOL1\n', 'latin1');
+
+const TYPES = {
+    f64: Float64Array,
+    i32: Int32Array,
+    i64: BigInt64Array
+};
+
+class ColumnWriter {
+    constructor(path, columns) {
+        this.fd = fs.openSync(path, 'w');
+        this.columns = columns;
+        this.groups = [];
+        this.offset = 0;
+        this.write(MAGIC);
+    }
+
+    write(buffer) {
+        fs.writeSync(this.fd, buffer, 0, buffer.length, this.offset);
+        this.offset += buffer.length;
+    }
+
+    // values: { sarakkeen nimi: typed array }, kaikki saman mittaisia
+    writeGroup(values, rows) {
+        const group = { rows, columns: {} };
+        for (const { name, type } of this.columns) {
+            const array = values[name].subarray(0, rows);
+            if (!(array instanceof TYPES[type])) {
+                throw new Error(`Sarake ${name} ei ole tyyppiä ${type}`);
+            }
+            let min = type === 'i64' ? array[0] : Infinity;
+            let max = type === 'i64' ? array[0] : -Infinity;
+            for (let i = 0; i < rows; i++) {
+                if (array[i] < min) min = array[i];
+                if (array[i] > max) max = array[i];
+            }
+            if (type === 'i64') {
+                min = String(min);
+                max = String(max);
+            }
+            const compressed = zlib.deflateRawSync(Buffer.from(array.buffer, array.byteOffset, array.byteLength), { level: 6 });
+            group.columns[name] = { offset: this.offset, length: compressed.length, min, max };
+            this.write(compressed);
+        }
+        this.groups.push(group);
+    }
+
+    close() {
+        const footer = Buffer.from(JSON.stringify({ columns: this.columns, groups: this.groups }));
+        const length = Buffer.alloc(4);
+        length.writeUInt32LE(footer.length, 0);
+        this.write(footer);
+        this.write(length);
+        this.write(MAGIC);
+        fs.closeSync(this.fd);
+    }
+}
+
+class ColumnReader {
+    constructor(path) {
+        this.fd = fs.openSync(path, 'r');
+        const size = fs.fstatSync(this.fd).size;
+        const tail = this.read(size - MAGIC.length - 4, MAGIC.length + 4);
+        if (!tail.subarray(4).equals(MAGIC)) {
+            throw new Error(`${path} ei ole ATMCOL1-tiedosto`);
+        }
+        const footerLength = tail.readUInt32LE(0);
+        const footer = JSON.parse(this.read(size - MAGIC.length - 4 - footerLength, footerLength).toString());
+        this.columns = footer.columns;
+        this.groups = footer.groups;
+        for (const { name, type } of this.columns) {
+            if (type !== 'i64') continue;
+            for (const group of this.groups) {
+                group.columns[name].min = BigInt(group.columns[name].min);
+                group.columns[name].max = BigInt(group.columns[name].max);
+            }
+        }
+        this.bytesRead = 0;
+    }
+
+    read(position, length) {
+        const buffer = Buffer.alloc(length);
+        fs.readSync(this.fd, buffer, 0, length, position);
+        return buffer;
+    }
+
+    // Purkaa yhden lohkon yhden sarakkeen typed arrayksi
+    column(group, name) {
+        const chunk = group.columns[name];
+        const type = this.columns.find((column) => column.name === name).type;
+        const raw = zlib.inflateRawSync(this.read(chunk.offset, chunk.length));
+        this.bytesRead += chunk.length;
+        // Kopio tasattuun puskuriin, koska inflate voi palauttaa tasaamattoman viipaleen
+        const aligned = new ArrayBuffer(raw.length);
+        new Uint8Array(aligned).set(raw);
+        return new TYPES[type](aligned);
+    }
+
+    close() {
+        fs.closeSync(this.fd);
+    }
+}
+
+module.exports = { ColumnWriter, ColumnReader };
@@ -0,0 +1,87 @@
+#!/usr/bin/env node
+// Vie transactions-taulun sarakepalamuotoon (ks. tools/columnar.js) avainjärjestyksessä
+// sivuttaen, joten muistinkäyttö pysyy yhden rivilohkon kokoisena taulun koosta riippumatta.
+// Summat tallennetaan kokonaislukusentteinä (i64), jotta summaus on tarkka.
+//
+// Käyttö:
+//   node tools/export_transactions.js --output transactions.atmcol --group 65536
+
+const { ColumnWriter } = require('./columnar');
+
+const COLUMNS = [
+    { name: 'transaction_id', type: 'f64' },
+    { name: 'transaction_time', type: 'f64' },   // millisekunteja epochista
+    { name: 'summa_cents', type: 'i64' },
+    { name: 'account_id', type: 'i32' }
+];
+
+const parseArgs = (argv) => {
+    const args = { output: 'transactions.atmcol', group: 65536 };
+    for (let i = 0; i < argv.length; i += 2) {
+        const key = argv[i].replace(/^--/, '');
+        if (!(key in args)) {
+            console.error(`Tuntematon valitsin: ${argv[i]}`);
+            process.exit(1);
+        }
+        args[key] = typeof args[key] === 'number' ? Number(argv[i + 1]) : argv[i + 1];
+    }
+    return args;
+};
+
+// DECIMAL-merkkijono (mysql2 palauttaa DECIMALin merkkijonona) senteiksi ilman liukulukuja
+const parseCents = (text) => {
+    const match = /^(-?)(\d+)(?:\.(\d{1,2}))?$/.exec(String(text).trim());
+    if (!match) throw new Error(`Virheellinen summa: ${text}`);
+    const cents = BigInt(match[2]) * 100n + BigInt((match[3] || '').padEnd(2, '0'));
+    return match[1] ? -cents : cents;
+};
+
+const main = async () => {
+    const args = parseArgs(process.argv.slice(2));
+    const db = require('../db');
+    const writer = new ColumnWriter(args.output, COLUMNS);
+
+    // Puskurit käytetään uudelleen jokaiselle lohkolle
+    const values = {
+        transaction_id: new Float64Array(args.group),
+        transaction_time: new Float64Array(args.group),
+        summa_cents: new BigInt64Array(args.group),
+        account_id: new Int32Array(args.group)
+    };
+
+    const started = Date.now();
+    let lastId = 0;
+    let total = 0;
+    try {
+        for (;;) {
+            // Avainjärjestetty sivutus: ei OFFSETia, joten jokainen sivu on indeksihaku
+            const rows = await db.query(
+                'SELECT transaction_id, transaction_time, summa, account_id FROM transactions WHERE transaction_id > ? ORDER BY transaction_id LIMIT ?',
+                [lastId, args.group]
+            );
+            if (rows.length === 0) break;
+
+            rows.forEach((row, i) => {
+                values.transaction_id[i] = row.transaction_id;
+                values.transaction_time[i] = new Date(row.transaction_time).getTime();
+                values.summa_cents[i] = parseCents(row.summa);
+                values.account_id[i] = row.account_id;
+            });
+            writer.writeGroup(values, rows.length);
+
+            lastId = rows[rows.length - 1].transaction_id;
+            total += rows.length;
+            console.log(`${total} tapahtumaa, viimeisin id ${lastId}`);
+            if (rows.length < args.group) break;
+        }
+        writer.close();
+        console.log(`Valmis: ${total} tapahtumaa ${((Date.now() - started) / 1000).toFixed(1)} s -> ${args.output}`);
+    } catch (error) {
+        console.error('Virhe:', error.message);
+        process.exitCode = 1;
+    } finally {
+        await db.pool.end();
+    }
+};
+
+main();
@@ -0,0 +1,70 @@
+#!/usr/bin/env node
+// Vertaa tokenin tarkistusta: jsonwebtoken.verify, natiivi HS256-tarkistus ja välimuisti.
+// Simuloi --sessions samanaikaista istuntoa, joiden tokenit esitetään vuorotellen.
+//
+// Käyttö:
+//   node tools/jwt_bench.js --requests 200000 --sessions 5000
+
+const crypto = require('crypto');
+const jwt = require('jsonwebtoken');
+const { verifyHs256, verifyCached } = require('../verifyToken');
+
+const JWT_SECRET = '1234567890';
+
+const parseArgs = (argv) => {
+    const args = { requests: 200000, sessions: 5000 };
+    for (let i = 0; i < argv.length; i += 2) {
+        const key = argv[i].replace(/^--/, '');
+        if (!(key in args)) {
+            console.error(`Tuntematon valitsin: ${argv[i]}`);
+            process.exit(1);
+        }
+        args[key] = Number(argv[i + 1]);
+    }
+    return args;
+};
+
+const measure = (label, tokens, requests, verify) => {
+    const samples = new Float64Array(Math.min(requests, 20000));
+    const every = Math.ceil(requests / samples.length);
+    const started = process.hrtime.bigint();
+    for (let i = 0; i < requests; i++) {
+        const token = tokens[(i * 7919) % tokens.length];
+        if (i % every === 0) {
+            const before = process.hrtime.bigint();
+            verify(token);
+            samples[i / every] = Number(process.hrtime.bigint() - before) / 1000;
+        } else {
+            verify(token);
+        }
+    }
+    const seconds = Number(process.hrtime.bigint() - started) / 1e9;
+    const sorted = Array.from(samples).sort((a, b) => a - b);
+    const p = (q) => sorted[Math.min(sorted.length - 1, Math.floor(sorted.length * q))].toFixed(2);
+    console.log(`${label.padEnd(16)} ${Math.round(requests / seconds).toString().padStart(9)} tarkistusta/s   p50 ${p(0.5)} µs   p99 ${p(0.99)} µs`);
+};
+
+const main = () => {
+    const args = parseArgs(process.argv.slice(2));
+    const tokens = Array.from({ length: args.sessions }, (unused, i) => jwt.sign({ account_id: i + 1 }, JWT_SECRET, { expiresIn: '1h' }));
+
+    // Tarkista, että kaikki toteutukset hyväksyvät samat tokenit ja hylkäävät väärennetyn
+    const forged = `${tokens[0].slice(0, tokens[0].lastIndexOf('.'))}.${crypto.randomBytes(32).toString('base64url')}`;
+    for (const verify of [(token) => jwt.verify(token, JWT_SECRET), verifyHs256, verifyCached]) {
+        if (verify(tokens[0]).account_id !== 1) throw new Error('Token hylättiin virheellisesti');
+        let rejected = false;
+        try {
+            verify(forged);
+        } catch (error) {
+            rejected = true;
+        }
+        if (!rejected) throw new Error('Väärennetty token hyväksyttiin');
+    }
+
+    console.log(`${args.requests} pyyntöä, ${args.sessions} istuntoa`);
+    measure('jsonwebtoken', tokens, args.requests, (token) => jwt.verify(token, JWT_SECRET));
+    measure('natiivi HS256', tokens, args.requests, verifyHs256);
+    measure('välimuisti', tokens, args.requests, verifyCached);
+};
+
+main();
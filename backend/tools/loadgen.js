@@ -0,0 +1,224 @@
+#!/usr/bin/env node
+// Kuormageneraattori: simuloi N automaattia, jotka ajavat istuntoja paikallista backendia vastaan.
+//
+// Käyttö:
+//   node tools/loadgen.js --url http://localhost:3000 --atms 500 --duration 60 \
+//       --mix auth=20,balance=25,history=15,withdraw=30,topup=10 --think 2000 \
+//       --cards cards.json
+//
+// cards.json: [{ "card_number": "...", "pin_code": "1234", "account_id": 1 }, ...]
+//
+// Kaikki simuloidut automaatit tulevat samasta osoitteesta, ja backend rajoittaa sekä
+// jonottaa osoitteen eikä X-ATM-Id-otsakkeen mukaan. Nosta RATE_LIMIT_ATM_PER_MINUTE ja
+// RATE_LIMIT_ATM_BURST kohdepalvelimella, jos tunnistautumiset halutaan mitata ilman 429-vastauksia.
+
+const http = require('http');
+const fs = require('fs');
+
+const parseArgs = (argv) => {
+    const args = {
+        url: 'http://localhost:3000',
+        atms: 100,
+        duration: 30,
+        mix: 'auth=20,balance=25,history=15,withdraw=30,topup=10',
+        think: 2000,
+        cards: null
+    };
+    for (let i = 0; i < argv.length; i += 2) {
+        const key = argv[i].replace(/^--/, '');
+        if (!(key in args)) {
+            console.error(`Tuntematon valitsin: ${argv[i]}`);
+            process.exit(1);
+        }
+        args[key] = typeof args[key] === 'number' ? Number(argv[i + 1]) : argv[i + 1];
+    }
+    return args;
+};
+
+const parseMix = (text) => {
+    const entries = text.split(',').map((part) => {
+        const [name, weight] = part.split('=');
+        return { name: name.trim(), weight: Number(weight) };
+    });
+    const total = entries.reduce((sum, entry) => sum + entry.weight, 0);
+    let cumulative = 0;
+    return entries.map((entry) => {
+        cumulative += entry.weight / total;
+        return { name: entry.name, upTo: cumulative };
+    });
+};
+
+const pickScenario = (mix) => {
+    const r = Math.random();
+    return (mix.find((entry) => r <= entry.upTo) || mix[mix.length - 1]).name;
+};
+
+// Eksponentiaalisesti jakautunut miettimisaika keskiarvolla `mean` ms
+const thinkTime = (mean) => -Math.log(1 - Math.random()) * mean;
+
+const withdrawalAmount = () => {
+    const presets = [20, 40, 50, 100];
+    if (Math.random() < 0.8) {
+        return presets[Math.floor(Math.random() * presets.length)];
+    }
+    return 10 * (1 + Math.floor(Math.random() * 50));
+};
+
+class Stats {
+    constructor() {
+        this.latencies = new Map();
+        this.errors = new Map();
+        this.completed = 0;
+    }
+
+    record(scenario, ms) {
+        if (!this.latencies.has(scenario)) this.latencies.set(scenario, []);
+        this.latencies.get(scenario).push(ms);
+        this.completed++;
+    }
+
+    error(scenario, reason) {
+        const key = `${scenario} ${reason}`;
+        this.errors.set(key, (this.errors.get(key) || 0) + 1);
+    }
+}
+
+const percentile = (sorted, p) => {
+    if (sorted.length === 0) return 0;
+    const index = Math.min(sorted.length - 1, Math.ceil(p * sorted.length) - 1);
+    return sorted[Math.max(0, index)];
+};
+
+class VirtualAtm {
+    constructor(id, args, card, stats) {
+        this.id = `loadgen-${id}`;
+        this.base = new URL(args.url);
+        this.card = card;
+        this.stats = stats;
+        this.cookie = null;
+        // Yksi pysyvä yhteys per automaatti, kuten Qt-asiakkaalla
+        this.agent = new http.Agent({ keepAlive: true, maxSockets: 1 });
+    }
+
+    post(path, body) {
+        return new Promise((resolve) => {
+            const data = JSON.stringify(body);
+            const headers = {
+                'Content-Type': 'application/json',
+                'Content-Length': Buffer.byteLength(data),
+                'X-ATM-Id': this.id,
+                'X-Request-Deadline': String(Date.now() + 10000)
+            };
+            if (this.cookie) headers.Cookie = this.cookie;
+
+            const req = http.request({
+                hostname: this.base.hostname,
+                port: this.base.port,
+                path,
+                method: 'POST',
+                headers,
+                agent: this.agent,
+                timeout: 10000
+            }, (res) => {
+                const chunks = [];
+                res.on('data', (chunk) => chunks.push(chunk));
+                res.on('end', () => {
+                    const setCookie = res.headers['set-cookie'];
+                    if (setCookie) this.cookie = setCookie[0].split(';')[0];
+                    resolve({ status: res.statusCode, body: Buffer.concat(chunks) });
+                });
+            });
+            req.on('timeout', () => req.destroy(new Error('timeout')));
+            req.on('error', (error) => resolve({ status: 0, error: error.code || error.message }));
+            req.end(data);
+        });
+    }
+
+    async timed(scenario, path, body) {
+        const start = process.hrtime.bigint();
+        const result = await this.post(path, body);
+        const ms = Number(process.hrtime.bigint() - start) / 1e6;
+        if (result.status === 200) {
+            this.stats.record(scenario, ms);
+        } else {
+            this.stats.error(scenario, result.status === 0 ? result.error : `HTTP ${result.status}`);
+        }
+        return result.status === 200;
+    }
+
+    async session(scenario) {
+        const { card_number, pin_code, account_id } = this.card;
+        const authenticated = await this.timed('auth', '/cards/auth', { card_number, pin_code });
+        if (!authenticated || scenario === 'auth') return;
+
+        switch (scenario) {
+        case 'balance':
+            await this.timed(scenario, '/transactions/balance', { card_number, pin_code });
+            break;
+        case 'history':
+            await this.timed(scenario, '/transactions/get_transactions', { account_id });
+            break;
+        case 'withdraw':
+            await this.timed(scenario, '/transactions/withdraw', { card_number, pin_code, amount: withdrawalAmount() });
+            break;
+        case 'topup':
+            await this.timed(scenario, '/transactions/top_up', { account_id, amount: withdrawalAmount() });
+            break;
+        default:
+            this.stats.error(scenario, 'unknown scenario');
+        }
+    }
+
+    async run(mix, think, until) {
+        // Hajauta aloitukset, ettei kaikki automaatit käynnisty samalla millisekunnilla
+        await new Promise((resolve) => setTimeout(resolve, Math.random() * think));
+        while (Date.now() < until) {
+            await this.session(pickScenario(mix));
+            await new Promise((resolve) => setTimeout(resolve, thinkTime(think)));
+        }
+        this.agent.destroy();
+    }
+}
+
+const report = (stats, seconds) => {
+    console.log(`\nValmiita pyyntöjä: ${stats.completed}, ${(stats.completed / seconds).toFixed(1)} req/s`);
+    console.log('skenaario        n        p50 ms    p99 ms    p999 ms');
+    for (const [scenario, values] of stats.latencies) {
+        const sorted = Float64Array.from(values).sort();
+        console.log(
+            scenario.padEnd(12),
+            String(sorted.length).padStart(8),
+            percentile(sorted, 0.5).toFixed(1).padStart(10),
+            percentile(sorted, 0.99).toFixed(1).padStart(9),
+            percentile(sorted, 0.999).toFixed(1).padStart(10)
+        );
+    }
+    if (stats.errors.size > 0) {
+        console.log('\nVirheet:');
+        for (const [key, count] of stats.errors) {
+            console.log(`  ${key}: ${count}`);
+        }
+    }
+};
+
+const main = async () => {
+    const args = parseArgs(process.argv.slice(2));
+    const mix = parseMix(args.mix);
+    const cards = args.cards
+        ? JSON.parse(fs.readFileSync(args.cards, 'utf8'))
+        : [{ card_number: process.env.CARD_NUMBER || '0600062211', pin_code: process.env.PIN_CODE || '1234', account_id: Number(process.env.ACCOUNT_ID) || 1 }];
+
+    const stats = new Stats();
+    const started = Date.now();
+    const until = started + args.duration * 1000;
+    const atms = [];
+    for (let i = 0; i < args.atms; i++) {
+        atms.push(new VirtualAtm(i, args, cards[i % cards.length], stats));
+    }
+
+    console.log(`Ajetaan ${args.atms} automaattia ${args.duration} s osoitteeseen ${args.url}`);
+    await Promise.all(atms.map((atm) => atm.run(mix, args.think, until)));
+    report(stats, (Date.now() - started) / 1000);
+};
+
+main();
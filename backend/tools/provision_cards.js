@@ -0,0 +1,201 @@
+#!/usr/bin/env node
+// Korttien massaluonti: lukee CSV- tai NDJSON-tiedoston, laskee PIN-tiivisteet kaikilla
+// ytimillä (bcryptin libuv-säiealue) ja kirjoittaa kortit monirivisinä INSERT-lauseina.
+// Eteneminen tallennetaan tilatiedostoon, joten keskeytynyt ajo voidaan jatkaa.
+//
+// Käyttö:
+//   node tools/provision_cards.js --input cards.csv --batch 1000 --state cards.csv.state
+//   node tools/provision_cards.js --input cards.ndjson --resume true
+//   node tools/provision_cards.js --bench 200           # tiivisteitä/s/ydin, ei tietokantaa
+//
+// CSV: otsikkorivi card_number,pin_code,account_id,card_type,credit_limit
+// NDJSON: { "card_number": "...", "pin_code": "1234", "account_id": 1, "card_type": "debit" }
+
+const os = require('os');
+
+// Säiealueen koko on asetettava ennen kuin bcrypt käyttää sitä ensimmäisen kerran
+const cores = os.cpus().length;
+process.env.UV_THREADPOOL_SIZE = process.env.UV_THREADPOOL_SIZE || String(cores);
+
+const fs = require('fs');
+const readline = require('readline');
+const bcrypt = require('bcrypt');
+
+const parseArgs = (argv) => {
+    const args = { input: null, batch: 1000, rounds: 10, state: null, resume: 'false', bench: 0 };
+    for (let i = 0; i < argv.length; i += 2) {
+        const key = argv[i].replace(/^--/, '');
+        if (!(key in args)) {
+            console.error(`Tuntematon valitsin: ${argv[i]}`);
+            process.exit(1);
+        }
+        args[key] = typeof args[key] === 'number' ? Number(argv[i + 1]) : argv[i + 1];
+    }
+    if (!args.input && !args.bench) {
+        console.error('--input tai --bench on pakollinen');
+        process.exit(1);
+    }
+    args.state = args.state || `${args.input}.state`;
+    args.resume = args.resume === 'true';
+    return args;
+};
+
+// Palauttaa async-iteraattorin kortti-olioista riippumatta tiedostomuodosta
+async function* readCards(path) {
+    const lines = readline.createInterface({ input: fs.createReadStream(path), crlfDelay: Infinity });
+    let header = null;
+    for await (const line of lines) {
+        if (!line.trim()) continue;
+        if (line.trimStart().startsWith('{')) {
+            yield JSON.parse(line);
+            continue;
+        }
+        const fields = line.split(',').map((field) => field.trim());
+        if (!header) {
+            header = fields;
+            continue;
+        }
+        const card = {};
+        header.forEach((name, index) => {
+            card[name] = fields[index];
+        });
+        yield card;
+    }
+}
+
+const validate = (card, line) => {
+    if (!card.card_number || !card.pin_code || !card.account_id || !card.card_type) {
+        throw new Error(`Rivi ${line}: card_number, pin_code, account_id ja card_type ovat pakollisia`);
+    }
+};
+
+// Kaikki erän tiivisteet jonoon kerralla: säiealue jakaa ne vapaille ytimille
+const hashBatch = (cards, rounds) => Promise.all(cards.map((card) => bcrypt.hash(String(card.pin_code), rounds).then((pinHash) => [
+    card.card_number,
+    pinHash,
+    Number(card.account_id),
+    card.card_type,
+    card.credit_limit === undefined || card.credit_limit === '' ? null : Number(card.credit_limit)
+])));
+
+const readState = (path) => {
+    try {
+        return JSON.parse(fs.readFileSync(path, 'utf8')).done || 0;
+    } catch (error) {
+        return 0;
+    }
+};
+
+const writeState = (path, done) => {
+    fs.writeFileSync(`${path}.tmp`, JSON.stringify({ done, updated: new Date().toISOString() }));
+    fs.renameSync(`${path}.tmp`, path);
+};
+
+const insertBatch = async (db, rows, checkExisting) => {
+    if (checkExisting) {
+        // Jatkettaessa edellinen ajo on voinut kirjoittaa erän ennen tilan tallennusta
+        const existing = await db.query('SELECT card_number FROM cards WHERE card_number IN (?)', [rows.map((row) => row[0])]);
+        const found = new Set(existing.map((row) => row.card_number));
+        rows = rows.filter((row) => !found.has(row[0]));
+        if (rows.length === 0) return 0;
+    }
+    await db.query('INSERT INTO cards (card_number, pin_hash, account_id, card_type, credit_limit) VALUES ?', [rows]);
+    return rows.length;
+};
+
+const provision = async (args) => {
+    const db = require('../db');
+    const skip = args.resume ? readState(args.state) : 0;
+    if (skip > 0) console.log(`Jatketaan: ${skip} korttia on jo luotu`);
+
+    const started = Date.now();
+    let lastReport = started;
+    let done = skip;
+    let inserted = 0;
+    let index = 0;
+    let checkExisting = args.resume && skip > 0;
+    let batch = [];
+    let pendingHash = null;
+    let pendingCount = 0;
+
+    // Putki: seuraavan erän tiivisteet lasketaan sillä aikaa kun edellinen kirjoitetaan
+    const flush = async () => {
+        if (!pendingHash) return;
+        const rows = await pendingHash;
+        inserted += await insertBatch(db, rows, checkExisting);
+        checkExisting = false;
+        done += pendingCount;
+        writeState(args.state, done);
+        pendingHash = null;
+
+        const now = Date.now();
+        if (now - lastReport >= 2000) {
+            const rate = (done - skip) / ((now - started) / 1000);
+            console.log(`${done} korttia, ${rate.toFixed(0)} korttia/s (${(rate / cores).toFixed(1)}/ydin)`);
+            lastReport = now;
+        }
+    };
+
+    for await (const card of readCards(args.input)) {
+        index++;
+        if (index <= skip) continue;
+        validate(card, index);
+        batch.push(card);
+        if (batch.length >= args.batch) {
+            const next = hashBatch(batch, args.rounds);
+            await flush();
+            pendingHash = next;
+            pendingCount = batch.length;
+            batch = [];
+        }
+    }
+    if (batch.length > 0) {
+        const next = hashBatch(batch, args.rounds);
+        await flush();
+        pendingHash = next;
+        pendingCount = batch.length;
+    }
+    await flush();
+
+    const seconds = (Date.now() - started) / 1000;
+    const rate = (done - skip) / Math.max(seconds, 0.001);
+    console.log(`Valmis: ${inserted} uutta korttia ${seconds.toFixed(1)} s, ${rate.toFixed(0)} korttia/s, ${(rate / cores).toFixed(1)} korttia/s/ydin`);
+    await db.pool.end();
+};
+
+// Mittaa tiivistyksen läpäisyn eri säiemäärillä ilman tietokantaa
+const bench = async (args) => {
+    const threads = Number(process.env.UV_THREADPOOL_SIZE);
+    console.log(`bcrypt-kierrokset ${args.rounds}, säiealue ${threads}, ytimiä ${cores}`);
+    for (let parallel = 1; parallel <= threads; parallel *= 2) {
+        let next = 0;
+        const started = process.hrtime.bigint();
+        const worker = async () => {
+            while (next < args.bench) {
+                next++;
+                await bcrypt.hash('1234', args.rounds);
+            }
+        };
+        await Promise.all(Array.from({ length: parallel }, worker));
+        const seconds = Number(process.hrtime.bigint() - started) / 1e9;
+        const rate = args.bench / seconds;
+        console.log(`${String(parallel).padStart(3)} rinnakkain: ${rate.toFixed(0).padStart(6)} korttia/s, ${(rate / parallel).toFixed(1)} korttia/s/ydin`);
+        if (parallel * 2 > threads && parallel !== threads) parallel = threads / 2;
+    }
+};
+
+const main = async () => {
+    const args = parseArgs(process.argv.slice(2));
+    try {
+        if (args.bench) {
+            await bench(args);
+        } else {
+            await provision(args);
+        }
+    } catch (error) {
+        console.error('Virhe:', error.message);
+        process.exit(1);
+    }
+};
+
+main();
@@ -0,0 +1,167 @@
+#!/usr/bin/env node
+// Toistaa Qt-asiakkaan kaappaaman liikenteen (ATM_CAPTURE_FILE) mitä tahansa backendia vastaan.
+// Istunnot (X-Trace-Id) ajetaan rinnakkain, mutta kunkin istunnon pyynnöt
+// alkuperäisessä järjestyksessä ja alkuperäisin välein jaettuna nopeuskertoimella.
+//
+// Kaappaus ei sisällä automaatin tunnistetta, ja kaikki toistetut istunnot tulevat samasta
+// osoitteesta, joten backendin automaattikohtainen rajoitin (rateLimiter.js) näkee ne yhtenä
+// automaattina. Nosta toistoajoa varten RATE_LIMIT_ATM_PER_MINUTE ja RATE_LIMIT_ATM_BURST
+// kohdepalvelimella, muuten /cards/auth-pyynnöt saavat 429-vastauksia.
+//
+// Käyttö:
+//   node tools/replay.js --capture atm.cap --url http://localhost:3000 --speed 10 --pin 1234
+
+const http = require('http');
+const fs = require('fs');
+
+const parseArgs = (argv) => {
+    const args = { capture: null, url: 'http://localhost:3000', speed: 1, pin: '1234' };
+    for (let i = 0; i < argv.length; i += 2) {
+        const key = argv[i].replace(/^--/, '');
+        if (!(key in args)) {
+            console.error(`Tuntematon valitsin: ${argv[i]}`);
+            process.exit(1);
+        }
+        args[key] = typeof args[key] === 'number' ? Number(argv[i + 1]) : argv[i + 1];
+    }
+    if (!args.capture) {
+        console.error('--capture on pakollinen');
+        process.exit(1);
+    }
+    return args;
+};
+
+// Lukee QDataStream-muotoiset tietueet (ks. frontend/bank_automat/trafficrecorder.h)
+const readCapture = (path) => {
+    const buffer = fs.readFileSync(path);
+    const magic = 'ATMCAP1\n';
+    if (buffer.toString('latin1', 0, magic.length) !== magic) {
+        throw new Error(`${path} ei ole kaappaustiedosto`);
+    }
+
+    let offset = magic.length;
+    const readInt64 = () => {
+        const value = Number(buffer.readBigInt64BE(offset));
+        offset += 8;
+        return value;
+    };
+    const readInt32 = () => {
+        const value = buffer.readInt32BE(offset);
+        offset += 4;
+        return value;
+    };
+    const readBytes = () => {
+        const length = buffer.readUInt32BE(offset);
+        offset += 4;
+        if (length === 0xFFFFFFFF) return Buffer.alloc(0);
+        const value = buffer.subarray(offset, offset + length);
+        offset += length;
+        return value;
+    };
+
+    const records = [];
+    while (offset < buffer.length) {
+        records.push({
+            startUs: readInt64(),
+            durationUs: readInt64(),
+            traceId: readBytes().toString('latin1'),
+            path: readBytes().toString('utf8'),
+            requestBody: readBytes(),
+            status: readInt32(),
+            responseBody: readBytes()
+        });
+    }
+    return records;
+};
+
+const groupSessions = (records) => {
+    const sessions = new Map();
+    records.forEach((record, index) => {
+        // Kaappaukset ilman jäljitystunnistetta toistetaan kukin omana istuntonaan
+        const key = record.traceId || `untraced-${index}`;
+        if (!sessions.has(key)) sessions.set(key, []);
+        sessions.get(key).push(record);
+    });
+    return sessions;
+};
+
+const sleep = (ms) => new Promise((resolve) => setTimeout(resolve, Math.max(0, ms)));
+
+const replaySession = async (records, args, origin, replayStart, results) => {
+    const base = new URL(args.url);
+    const agent = new http.Agent({ keepAlive: true, maxSockets: 1 });
+    let cookie = null;
+
+    for (const record of records) {
+        // Säilytä ajoitus suhteessa koko kaappauksen alkuun
+        await sleep(replayStart + (record.startUs - origin) / 1000 / args.speed - Date.now());
+
+        const body = Buffer.from(record.requestBody.toString('utf8').replace(/("pin_code"\s*:\s*)"\*\*\*\*"/g, `$1"${args.pin}"`));
+        const headers = { 'Content-Type': 'application/json', 'Content-Length': body.length };
+        if (record.traceId) headers['X-Trace-Id'] = record.traceId;
+        if (cookie) headers.Cookie = cookie;
+
+        const started = process.hrtime.bigint();
+        const status = await new Promise((resolve) => {
+            const req = http.request({ hostname: base.hostname, port: base.port, path: record.path, method: 'POST', headers, agent }, (res) => {
+                const setCookie = res.headers['set-cookie'];
+                if (setCookie) cookie = setCookie[0].split(';')[0];
+                res.resume();
+                res.on('end', () => resolve(res.statusCode));
+            });
+            req.on('error', () => resolve(0));
+            req.end(body);
+        });
+
+        results.push({
+            path: record.path,
+            recordedMs: record.durationUs / 1000,
+            replayedMs: Number(process.hrtime.bigint() - started) / 1e6,
+            statusMatches: status === record.status,
+            rateLimited: status === 429 && record.status !== 429
+        });
+    }
+    agent.destroy();
+};
+
+const main = async () => {
+    const args = parseArgs(process.argv.slice(2));
+    const records = readCapture(args.capture);
+    if (records.length === 0) {
+        console.log('Kaappaus on tyhjä');
+        return;
+    }
+
+    const sessions = groupSessions(records);
+    // Ei levitystä argumenteiksi: suuri kaappaus ylittäisi kutsupinon rajan
+    const origin = records.reduce((earliest, record) => Math.min(earliest, record.startUs), Infinity);
+    const replayStart = Date.now();
+    const results = [];
+
+    console.log(`Toistetaan ${records.length} pyyntöä, ${sessions.size} istuntoa, nopeus ${args.speed}x`);
+    await Promise.all([...sessions.values()].map((session) => replaySession(session, args, origin, replayStart, results)));
+
+    const byPath = new Map();
+    for (const result of results) {
+        if (!byPath.has(result.path)) byPath.set(result.path, []);
+        byPath.get(result.path).push(result);
+    }
+    console.log('polku                               n   kaapattu ka ms  toistettu ka ms  eri tila');
+    for (const [path, entries] of byPath) {
+        const average = (key) => entries.reduce((sum, entry) => sum + entry[key], 0) / entries.length;
+        console.log(
+            path.padEnd(34),
+            String(entries.length).padStart(4),
+            average('recordedMs').toFixed(1).padStart(15),
+            average('replayedMs').toFixed(1).padStart(16),
+            String(entries.filter((entry) => !entry.statusMatches).length).padStart(9)
+        );
+    }
+
+    const rateLimited = results.filter((result) => result.rateLimited).length;
+    if (rateLimited > 0) {
+        console.log(`${rateLimited} pyyntöä rajoitettiin (429); nosta RATE_LIMIT_ATM_PER_MINUTE ja RATE_LIMIT_ATM_BURST toistoajoa varten`);
+    }
+};
+
+main();
@@ -0,0 +1,99 @@
+#!/usr/bin/env node
+// Laskee summat export_transactions.js:n tuottamasta tiedostosta. Lohkot, joiden
+// min/max-arvot eivät osu suodattimeen, ohitetaan, ja vain tarvittavat sarakkeet puretaan.
+// Summat lasketaan kokonaislukusentteinä (BigInt), joten tulos on tarkka rivimäärästä riippumatta.
+//
+// Käyttö:
+//   node tools/scan_transactions.js --file transactions.atmcol --by account
+//   node tools/scan_transactions.js --file transactions.atmcol --account 42 --from 2025-01-01 --to 2025-04-01
+//   node tools/scan_transactions.js --file transactions.atmcol --by month
+
+const { ColumnReader } = require('./columnar');
+
+const parseArgs = (argv) => {
+    const args = { file: null, by: 'account', account: null, from: null, to: null };
+    for (let i = 0; i < argv.length; i += 2) {
+        const key = argv[i].replace(/^--/, '');
+        if (!(key in args)) {
+            console.error(`Tuntematon valitsin: ${argv[i]}`);
+            process.exit(1);
+        }
+        args[key] = argv[i + 1];
+    }
+    if (!args.file) {
+        console.error('--file on pakollinen');
+        process.exit(1);
+    }
+    if (!['account', 'month', 'none'].includes(args.by)) {
+        console.error('--by: account, month tai none');
+        process.exit(1);
+    }
+    args.account = args.account === null ? null : Number(args.account);
+    args.from = args.from ? Date.parse(args.from) : -Infinity;
+    args.to = args.to ? Date.parse(args.to) : Infinity;
+    return args;
+};
+
+const overlaps = (stats, low, high) => stats.max >= low && stats.min <= high;
+
+const formatCents = (cents) => {
+    const negative = cents < 0n;
+    const magnitude = negative ? -cents : cents;
+    return `${negative ? '-' : ''}${magnitude / 100n}.${String(magnitude % 100n).padStart(2, '0')}`;
+};
+
+const main = () => {
+    const args = parseArgs(process.argv.slice(2));
+    const reader = new ColumnReader(args.file);
+    if (!reader.columns.some((column) => column.name === 'summa_cents')) {
+        console.error(`${args.file} on vanhaa muotoa (summa liukulukueuroina); vie tapahtumat uudelleen`);
+        process.exit(1);
+    }
+    const filterTime = args.from !== -Infinity || args.to !== Infinity;
+    const needAccount = args.account !== null || args.by === 'account';
+    const needTime = filterTime || args.by === 'month';
+
+    const started = process.hrtime.bigint();
+    const totals = new Map();
+    let scannedGroups = 0;
+    let matched = 0;
+
+    for (const group of reader.groups) {
+        // Lohkon tilastot: ohita, jos mikään rivi ei voi täsmätä
+        if (args.account !== null && !overlaps(group.columns.account_id, args.account, args.account)) continue;
+        if (filterTime && !overlaps(group.columns.transaction_time, args.from, args.to - 1)) continue;
+        scannedGroups++;
+
+        const cents = reader.column(group, 'summa_cents');
+        const accounts = needAccount ? reader.column(group, 'account_id') : null;
+        const times = needTime ? reader.column(group, 'transaction_time') : null;
+
+        for (let i = 0; i < group.rows; i++) {
+            if (args.account !== null && accounts[i] !== args.account) continue;
+            if (filterTime && (times[i] < args.from || times[i] >= args.to)) continue;
+
+            let key = 'kaikki';
+            if (args.by === 'account') {
+                key = accounts[i];
+            } else if (args.by === 'month') {
+                key = new Date(times[i]).toISOString().slice(0, 7);
+            }
+            const entry = totals.get(key) || { count: 0, sum: 0n };
+            entry.count++;
+            entry.sum += cents[i];
+            totals.set(key, entry);
+            matched++;
+        }
+    }
+    reader.close();
+
+    const keys = [...totals.keys()].sort((a, b) => (a < b ? -1 : a > b ? 1 : 0));
+    for (const key of keys) {
+        const entry = totals.get(key);
+        console.log(String(key).padEnd(12), String(entry.count).padStart(10), formatCents(entry.sum).padStart(16));
+    }
+    const ms = Number(process.hrtime.bigint() - started) / 1e6;
+    console.log(`${matched} riviä, ${scannedGroups}/${reader.groups.length} lohkoa, ${(reader.bytesRead / 1024).toFixed(0)} KiB luettu, ${ms.toFixed(1)} ms`);
+};
+
+main();
@@ -0,0 +1,255 @@
+#!/usr/bin/env node
+// Kuukausittaiset tiliotteet kaikille tileille. Tilit jaetaan säikeille (account_id % säikeet),
+// jokainen säie hakee tilinsä avainjärjestyksessä sivuittain, lukee kuukauden tapahtumat
+// virtana account_id-järjestyksessä ja kirjoittaa otteet suoraan uudelleenkäytettävään
+// puskuriin. Tulos: yksi tiedosto säiettä kohden, otteet sivunvaihdolla (\f) erotettuina.
+//
+// Käyttö:
+//   node tools/statements.js --month 2025-03 --out statements --workers 8 --page 1000
+
+const { Worker, isMainThread, parentPort, workerData } = require('worker_threads');
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+
+const parseArgs = (argv) => {
+    const args = { month: null, out: 'statements', workers: os.cpus().length, page: 1000 };
+    for (let i = 0; i < argv.length; i += 2) {
+        const key = argv[i].replace(/^--/, '');
+        if (!(key in args)) {
+            console.error(`Tuntematon valitsin: ${argv[i]}`);
+            process.exit(1);
+        }
+        args[key] = typeof args[key] === 'number' ? Number(argv[i + 1]) : argv[i + 1];
+    }
+    if (!/^\d{4}-\d{2}$/.test(args.month || '')) {
+        console.error('--month muodossa YYYY-MM on pakollinen');
+        process.exit(1);
+    }
+    return args;
+};
+
+// Tulospuskuri, johon kirjoitetaan suoraan tavuina ilman välimerkkijonoja
+class OutputBuffer {
+    constructor(fd, size = 1 << 20) {
+        this.fd = fd;
+        this.buffer = Buffer.allocUnsafe(size);
+        this.length = 0;
+    }
+
+    reserve(bytes) {
+        if (this.length + bytes > this.buffer.length) this.flush();
+    }
+
+    ascii(text) {
+        this.reserve(text.length);
+        this.length += this.buffer.latin1Write(text, this.length);
+    }
+
+    byte(code) {
+        this.reserve(1);
+        this.buffer[this.length++] = code;
+    }
+
+    // Kokonaisluku vähintään width numerolla etunollin
+    digits(value, width) {
+        this.reserve(20);
+        let start = this.length;
+        let remaining = Math.abs(value);
+        do {
+            this.buffer[this.length++] = 48 + (remaining % 10);
+            remaining = Math.floor(remaining / 10);
+        } while (remaining > 0 || this.length - start < width);
+        // Numerot kirjoitettiin käänteisessä järjestyksessä
+        for (let end = this.length - 1; start < end; start++, end--) {
+            const swap = this.buffer[start];
+            this.buffer[start] = this.buffer[end];
+            this.buffer[end] = swap;
+        }
+    }
+
+    // Sentit muodossa -1234.56, oikealle tasattuna kenttään
+    amount(cents, width) {
+        const whole = Math.floor(Math.abs(cents) / 100);
+        let used = 4 + (cents < 0 ? 1 : 0);
+        for (let rest = whole; rest >= 10; rest = Math.floor(rest / 10)) used++;
+        this.reserve(width + 24);
+        while (used++ < width) this.buffer[this.length++] = 32;
+        if (cents < 0) this.byte(45);
+        this.digits(whole, 1);
+        this.byte(46);
+        this.digits(Math.abs(cents) % 100, 2);
+    }
+
+    date(value) {
+        this.digits(value.getFullYear(), 4);
+        this.byte(45);
+        this.digits(value.getMonth() + 1, 2);
+        this.byte(45);
+        this.digits(value.getDate(), 2);
+        this.byte(32);
+        this.digits(value.getHours(), 2);
+        this.byte(58);
+        this.digits(value.getMinutes(), 2);
+    }
+
+    flush() {
+        if (this.length > 0) {
+            fs.writeSync(this.fd, this.buffer, 0, this.length);
+            this.length = 0;
+        }
+    }
+}
+
+const toCents = (value) => Math.round(parseFloat(value) * 100);
+
+const runWorker = async () => {
+    const { shard, shards, month, out, page } = workerData;
+    const db = require('../db');
+    const monthStart = new Date(`${month}-01T00:00:00`);
+    const monthEnd = new Date(monthStart.getFullYear(), monthStart.getMonth() + 1, 1);
+
+    let connection = null;
+    let fd = null;
+    let lastAccount = 0;
+    let statements = 0;
+    let transactions = 0;
+
+    // Yhteys ja tiedosto avataan try-lohkon sisällä, jotta kumpikaan ei jää auki, jos toinen epäonnistuu
+    try {
+        connection = await db.getConnection();
+        fd = fs.openSync(path.join(out, `statements-${month}-${String(shard).padStart(3, '0')}.txt`), 'w');
+        const output = new OutputBuffer(fd);
+        for (;;) {
+            const [accounts] = await connection.query(
+                'SELECT account_id, balance FROM accounts WHERE account_id > ? AND MOD(account_id, ?) = ? ORDER BY account_id LIMIT ?',
+                [lastAccount, shards, shard, page]
+            );
+            if (accounts.length === 0) break;
+            const ids = accounts.map((account) => account.account_id);
+            lastAccount = ids[ids.length - 1];
+
+            // Kortit ja kuun jälkeiset muutokset haetaan koko sivulle kerralla
+            const [cards] = await connection.query(
+                'SELECT account_id, card_number, card_type, credit_limit FROM cards WHERE account_id IN (?)', [ids]);
+            const [later] = await connection.query(
+                'SELECT account_id, SUM(summa) AS total FROM transactions WHERE account_id IN (?) AND transaction_time >= ? GROUP BY account_id',
+                [ids, monthEnd]);
+            const cardsByAccount = new Map();
+            for (const card of cards) {
+                if (!cardsByAccount.has(card.account_id)) cardsByAccount.set(card.account_id, []);
+                cardsByAccount.get(card.account_id).push(card);
+            }
+            const laterByAccount = new Map(later.map((row) => [row.account_id, toCents(row.total)]));
+
+            // Kuukauden tapahtumat virtana: muistissa vain yksi rivi kerrallaan
+            const stream = connection.connection.query(
+                'SELECT account_id, transaction_time, summa FROM transactions WHERE account_id IN (?) AND transaction_time >= ? AND transaction_time < ? ORDER BY account_id, transaction_time',
+                [ids, monthStart, monthEnd]
+            ).stream();
+
+            let index = -1;
+            let monthTotal = 0;
+            let closing = 0;
+            const header = (account) => {
+                closing = toCents(account.balance) - (laterByAccount.get(account.account_id) || 0);
+                monthTotal = 0;
+                output.ascii('TILIOTE ');
+                output.ascii(month);
+                output.ascii('   TILI ');
+                output.digits(account.account_id, 1);
+                output.byte(10);
+                for (const card of cardsByAccount.get(account.account_id) || []) {
+                    output.ascii('Kortti ****');
+                    output.ascii(String(card.card_number).slice(-4));
+                    output.ascii(card.card_type === 'credit' ? '  luotto, raja ' : '  debit');
+                    if (card.card_type === 'credit') output.amount(toCents(card.credit_limit || 0), 1);
+                    output.byte(10);
+                }
+                output.ascii('----------------------------------------\n');
+            };
+            const footer = () => {
+                output.ascii('----------------------------------------\n');
+                output.ascii('Alkusaldo      ');
+                output.amount(closing - monthTotal, 16);
+                output.ascii('\nLoppusaldo     ');
+                output.amount(closing, 16);
+                output.ascii('\n\f');
+                statements++;
+            };
+            const advanceTo = (accountId) => {
+                while (index < accounts.length - 1 && (index < 0 || accounts[index].account_id !== accountId)) {
+                    if (index >= 0) footer();
+                    index++;
+                    header(accounts[index]);
+                }
+            };
+
+            for await (const row of stream) {
+                advanceTo(row.account_id);
+                const cents = toCents(row.summa);
+                monthTotal += cents;
+                output.date(row.transaction_time);
+                output.amount(cents, 24);
+                output.byte(10);
+                transactions++;
+            }
+            // Loput sivun tilit (myös ne, joilla ei ollut tapahtumia)
+            while (index < accounts.length - 1) {
+                if (index >= 0) footer();
+                index++;
+                header(accounts[index]);
+            }
+            if (index >= 0) footer();
+
+            parentPort.postMessage({ statements, transactions });
+        }
+        output.flush();
+    } finally {
+        if (fd !== null) fs.closeSync(fd);
+        if (connection) connection.release();
+        await db.pool.end();
+    }
+    parentPort.postMessage({ statements, transactions, done: true });
+};
+
+const main = () => {
+    const args = parseArgs(process.argv.slice(2));
+    fs.mkdirSync(args.out, { recursive: true });
+
+    const started = Date.now();
+    const progress = new Array(args.workers).fill(null).map(() => ({ statements: 0, transactions: 0 }));
+    const report = (final) => {
+        const statements = progress.reduce((sum, entry) => sum + entry.statements, 0);
+        const transactions = progress.reduce((sum, entry) => sum + entry.transactions, 0);
+        const hours = (Date.now() - started) / 3600000;
+        console.log(`${final ? 'Valmis: ' : ''}${statements} otetta, ${transactions} tapahtumaa, ${Math.round(statements / Math.max(hours, 1e-9))} otetta/h`);
+    };
+    const timer = setInterval(() => report(false), 5000);
+
+    let running = args.workers;
+    for (let shard = 0; shard < args.workers; shard++) {
+        const worker = new Worker(__filename, {
+            workerData: { shard, shards: args.workers, month: args.month, out: args.out, page: args.page }
+        });
+        worker.on('message', (message) => {
+            progress[shard] = message;
+        });
+        worker.on('error', (error) => {
+            console.error(`Säie ${shard}:`, error.message);
+            process.exitCode = 1;
+        });
+        worker.on('exit', () => {
+            if (--running === 0) {
+                clearInterval(timer);
+                report(true);
+            }
+        });
+    }
+};
+
+if (isMainThread) {
+    main();
+} else {
+    runWorker();
+}
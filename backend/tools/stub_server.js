@@ -0,0 +1,290 @@
+#!/usr/bin/env node
+// Deterministinen korvike backendille: sama JSON-sopimus kuin /cards/auth ja
+// /transactions/{withdraw,top_up,balance,get_transactions}, mutta muistissa olevilla
+// kiintoarvoilla ja säädettävällä viiveellä sekä vikojen injektoinnilla.
+//
+// Käyttö:
+//   node tools/stub_server.js --port 3000 --seed 42 --latency uniform:20-150 \
+//       --error-rate 0.02 --truncate-rate 0.01 --drip-rate 0.01 --drip-ms 200 \
+//       --fixtures fixtures.json
+//
+// Viivejakaumat: fixed:<ms>, uniform:<min>-<max>, normal:<mean>,<stddev>, exp:<mean>
+
+const http = require('http');
+const fs = require('fs');
+const { LimitLedger } = require('../limitRules');
+
+const parseArgs = (argv) => {
+    const args = {
+        port: 3000,
+        seed: 1,
+        latency: 'fixed:0',
+        'error-rate': 0,
+        'truncate-rate': 0,
+        'drip-rate': 0,
+        'drip-ms': 100,
+        fixtures: null
+    };
+    for (let i = 0; i < argv.length; i += 2) {
+        const key = argv[i].replace(/^--/, '');
+        if (!(key in args)) {
+            console.error(`Tuntematon valitsin: ${argv[i]}`);
+            process.exit(1);
+        }
+        args[key] = typeof args[key] === 'number' ? Number(argv[i + 1]) : argv[i + 1];
+    }
+    return args;
+};
+
+// mulberry32: toistettava satunnaislukusarja siemenestä
+const createRandom = (seed) => {
+    let state = seed >>> 0;
+    return () => {
+        state = (state + 0x6D2B79F5) >>> 0;
+        let t = state;
+        t = Math.imul(t ^ (t >>> 15), t | 1);
+        t ^= t + Math.imul(t ^ (t >>> 7), t | 61);
+        return ((t ^ (t >>> 14)) >>> 0) / 4294967296;
+    };
+};
+
+const createLatency = (spec, random) => {
+    const [kind, params] = spec.split(':');
+    switch (kind) {
+    case 'fixed':
+        return () => Number(params);
+    case 'uniform': {
+        const [min, max] = params.split('-').map(Number);
+        return () => min + random() * (max - min);
+    }
+    case 'normal': {
+        const [mean, stddev] = params.split(',').map(Number);
+        return () => {
+            const u = 1 - random();
+            const v = random();
+            return Math.max(0, mean + stddev * Math.sqrt(-2 * Math.log(u)) * Math.cos(2 * Math.PI * v));
+        };
+    }
+    case 'exp':
+        return () => -Math.log(1 - random()) * Number(params);
+    default:
+        console.error(`Tuntematon viivejakauma: ${spec}`);
+        process.exit(1);
+    }
+};
+
+const defaultFixtures = {
+    cards: [
+        { card_number: '0600062211', pin_code: '1234', account_id: 1, card_type: 'debit', credit_limit: null },
+        { card_number: '0600062212', pin_code: '1234', account_id: 2, card_type: 'credit', credit_limit: 1000 }
+    ],
+    accounts: [
+        { account_id: 1, customer_id: 1, balance: 1500 },
+        { account_id: 2, customer_id: 2, balance: -200 }
+    ],
+    customers: [
+        { customer_id: 1, first_name: 'Matti', last_name: 'Meikäläinen' },
+        { customer_id: 2, first_name: 'Maija', last_name: 'Virtanen' }
+    ]
+};
+
+class Bank {
+    constructor(fixtures) {
+        this.cards = new Map(fixtures.cards.map((card) => [card.card_number, Object.assign({ failed_pin_attempts: 0, is_blocked: 0 }, card)]));
+        this.accounts = new Map(fixtures.accounts.map((account) => [account.account_id, Object.assign({}, account)]));
+        this.customers = new Map(fixtures.customers.map((customer) => [customer.customer_id, customer]));
+        this.transactions = [];
+        this.nextTransactionId = 1;
+        // Kiinteä aloitushetki pitää aikaleimat toistettavina ajosta toiseen
+        this.clock = Date.UTC(2025, 0, 1);
+        // Samat nostorajat kuin backendissa, mutta stubin kellolla
+        this.limitLedger = new LimitLedger({ now: () => new Date(this.clock) });
+    }
+
+    // summa tallennetaan kuten mysql2 palauttaa DECIMAL-sarakkeen: merkkijonona ("-40.00")
+    record(accountId, summa) {
+        this.clock += 1000;
+        this.transactions.push({
+            transaction_id: this.nextTransactionId++,
+            transaction_time: new Date(this.clock).toISOString(),
+            summa: summa.toFixed(2),
+            account_id: accountId
+        });
+    }
+
+    checkPin(card, pinCode) {
+        if (card.pin_code === pinCode) {
+            card.failed_pin_attempts = 0;
+            return true;
+        }
+        card.failed_pin_attempts++;
+        if (card.failed_pin_attempts >= 3) card.is_blocked = 1;
+        return false;
+    }
+
+    auth({ card_number, pin_code }) {
+        if (!card_number || !pin_code) return [400, { error: 'card_number and pin_code are required' }];
+        const card = this.cards.get(card_number);
+        if (!card) return [404, { error: 'Korttia ei löydy' }];
+        if (card.is_blocked) return [403, { error: 'Kortti on estetty' }];
+        if (!this.checkPin(card, pin_code)) {
+            return [403, { error: card.is_blocked ? 'Kortti on estetty' : 'Väärä PIN-koodi' }];
+        }
+        const account = this.accounts.get(card.account_id);
+        if (!account) return [404, { error: 'Account not found' }];
+        const customer = this.customers.get(account.customer_id);
+        if (!customer) return [404, { error: 'Customer not found' }];
+        return [200, {
+            success: true,
+            customer: { first_name: customer.first_name, last_name: customer.last_name },
+            account_id: card.account_id,
+            card_type: card.card_type
+        }];
+    }
+
+    withdraw({ card_number, pin_code, amount }) {
+        if (!card_number || !pin_code || !amount) return [400, { error: 'card_number, pin_code, and amount are required' }];
+        const withdrawalAmount = parseFloat(amount);
+        if (isNaN(withdrawalAmount) || withdrawalAmount <= 0) return [400, { error: 'Amount must be a positive number' }];
+        const card = this.cards.get(card_number);
+        if (!card) return [404, { error: 'Kortti ei ole olemassa' }];
+        if (card.is_blocked) return [403, { error: 'Kortti on estetty' }];
+        if (!this.checkPin(card, pin_code)) {
+            return [403, { error: card.is_blocked ? 'Vaara PIN-koodi. Kortti on estetty 3 vaaran yrityksen jalkeen.' : 'Vaara PIN-koodi' }];
+        }
+        const account = this.accounts.get(card.account_id);
+        if (!account) return [404, { error: 'Account not found' }];
+        if (card.card_type === 'credit') {
+            const usedCredit = account.balance < 0 ? -account.balance : 0;
+            if (withdrawalAmount > card.credit_limit - usedCredit) return [400, { error: 'Riittamattomat varat: Luottoraja ylitetty' }];
+        } else if (account.balance < withdrawalAmount) {
+            return [400, { error: 'Riittamattomat varat' }];
+        }
+        const limitError = this.limitLedger.reserve(card_number, card.account_id, withdrawalAmount);
+        if (limitError) return [403, { error: limitError }];
+        account.balance = Math.round((account.balance - withdrawalAmount) * 100) / 100;
+        this.record(account.account_id, -withdrawalAmount);
+        return [200, { message: 'Withdrawal successful', transaction: { amount: withdrawalAmount, new_balance: account.balance } }];
+    }
+
+    balance({ card_number, pin_code }) {
+        if (!card_number || !pin_code) return [400, { error: 'card_number and pin_code are required' }];
+        const card = this.cards.get(card_number);
+        if (!card) return [404, { error: 'Card not found' }];
+        const account = this.accounts.get(card.account_id);
+        if (!account) return [404, { error: 'Account not found' }];
+        const available = card.card_type === 'credit'
+            ? card.credit_limit - (account.balance < 0 ? -account.balance : 0)
+            : Math.max(0, account.balance);
+        return [200, { message: 'Balance retrieved successfully', balance: account.balance, available, card_type: card.card_type }];
+    }
+
+    topUp({ account_id, amount }) {
+        if (!account_id || !amount || amount <= 0) return [400, { error: 'account_id and a positive amount are required' }];
+        const account = this.accounts.get(Number(account_id));
+        if (!account) return [404, { error: 'Account not found' }];
+        account.balance = Math.round((account.balance + parseFloat(amount)) * 100) / 100;
+        this.record(account.account_id, parseFloat(amount));
+        return [200, { success: true, newBalance: account.balance }];
+    }
+
+    // Sama laskuri ja säännöt kuin limits.js: päivän nostot kortti- ja tilikohtaisesti
+    limits({ card_number }) {
+        if (!card_number) return [400, { error: 'card_number is required' }];
+        const card = this.cards.get(card_number);
+        if (!card) return [404, { error: 'Card not found' }];
+        return [200, this.limitLedger.remaining(card_number, card.account_id)];
+    }
+
+    history({ account_id }) {
+        if (!account_id) return [400, { error: 'account_id is required' }];
+        const rows = this.transactions.filter((tx) => tx.account_id === Number(account_id));
+        return [200, rows.slice(-10).reverse()];
+    }
+}
+
+const main = () => {
+    const args = parseArgs(process.argv.slice(2));
+    const random = createRandom(args.seed);
+    const latency = createLatency(args.latency, random);
+    const fixtures = args.fixtures ? JSON.parse(fs.readFileSync(args.fixtures, 'utf8')) : defaultFixtures;
+    const bank = new Bank(fixtures);
+    const faults = { injected_errors: 0, truncated: 0, dripped: 0 };
+
+    const routes = {
+        '/cards/auth': (body) => bank.auth(body),
+        '/transactions/withdraw': (body) => bank.withdraw(body),
+        '/transactions/balance': (body) => bank.balance(body),
+        '/transactions/top_up': (body) => bank.topUp(body),
+        '/transactions/get_transactions': (body) => bank.history(body),
+        '/transactions/limits': (body) => bank.limits(body)
+    };
+
+    const send = (res, status, payload) => {
+        const data = Buffer.from(JSON.stringify(payload));
+        const headers = { 'Content-Type': 'application/json; charset=utf-8', 'Content-Length': data.length };
+        if (status === 200 && payload.success && payload.customer) {
+            headers['Set-Cookie'] = 'token=stub-token; Path=/; HttpOnly';
+        }
+
+        // Vikojen arvonta tehdään aina samassa järjestyksessä, jotta sama siemen toistaa saman ajon
+        const roll = random();
+        if (roll < args['truncate-rate']) {
+            faults.truncated++;
+            res.writeHead(status, headers);
+            res.write(data.subarray(0, Math.floor(data.length / 2)));
+            res.destroy();
+            return;
+        }
+        if (roll < args['truncate-rate'] + args['drip-rate']) {
+            faults.dripped++;
+            res.writeHead(status, headers);
+            let offset = 0;
+            const drip = () => {
+                if (offset >= data.length) return res.end();
+                res.write(data.subarray(offset, offset + 8));
+                offset += 8;
+                setTimeout(drip, args['drip-ms']);
+            };
+            return drip();
+        }
+        res.writeHead(status, headers);
+        res.end(data);
+    };
+
+    const server = http.createServer((req, res) => {
+        const chunks = [];
+        req.on('data', (chunk) => chunks.push(chunk));
+        req.on('end', () => {
+            if (req.method === 'GET' && req.url === '/stub/faults') {
+                res.writeHead(200, { 'Content-Type': 'application/json; charset=utf-8' });
+                return res.end(JSON.stringify(faults));
+            }
+
+            const route = req.method === 'POST' ? routes[req.url] : null;
+            let body = {};
+            try {
+                body = chunks.length ? JSON.parse(Buffer.concat(chunks).toString('utf8')) : {};
+            } catch (error) {
+                return send(res, 400, { error: 'Invalid JSON' });
+            }
+
+            setTimeout(() => {
+                if (!route) return send(res, 404, { error: 'Not found' });
+                if (random() < args['error-rate']) {
+                    faults.injected_errors++;
+                    return send(res, 500, { error: 'Sisäinen palvelinvirhe' });
+                }
+                const [status, payload] = route(body);
+                send(res, status, payload);
+            }, latency());
+        });
+    });
+
+    server.keepAliveTimeout = 65000;
+    server.listen(args.port, () => {
+        console.log(`Stub-backend kuuntelee portissa ${args.port} (siemen ${args.seed}, viive ${args.latency})`);
+    });
+};
+
+main();
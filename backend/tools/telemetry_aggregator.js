@@ -0,0 +1,320 @@
+#!/usr/bin/env node
+// Automaattien telemetriakoostaja: vastaanottaa TelemetryReporterin UDP-kehykset,
+// säilyttää ne aikaämpäreissä muistissa ja vastaa kyselyihin HTTP:llä.
+//
+//   GET /top?window=300&n=10   hitaimmat automaatit (keskimääräinen viive) ikkunassa
+//   GET /atm/<id>              yhden automaatin viimeisimmät arvot ja ämpärit
+//
+// Tarkat ämpärit: 10 s, 15 min. Vanhemmat yhdistetään 5 min ämpäreihin, säilytys 24 h.
+// Ämpärit ovat automaattikohtaisissa rengaspuskureissa (typed array), joten muisti on
+// automaattien määrän mukainen eikä kasva ajan myötä.
+//
+// Käyttö:
+//   node tools/telemetry_aggregator.js --port 9500 --http 9501
+//   node tools/telemetry_aggregator.js --simulate 2000      (paikallinen testi simuloiduilla automaateilla)
+
+const dgram = require('dgram');
+const http = require('http');
+
+const FINE_MS = 10 * 1000;
+const FINE_SLOTS = 90;          // 15 min
+const COARSE_MS = 5 * 60 * 1000;
+const COARSE_SLOTS = 288;       // 24 h
+const FRAME_VERSION = 1;
+
+// Sarakkeet ämpäreissä: pyynnöt, virheet, viiveen summa (µs), muisti (kt, viimeisin)
+const REQUESTS = 0;
+const ERRORS = 1;
+const LATENCY_US = 2;
+const RSS_KB = 3;
+const FIELDS = 4;
+
+const parseArgs = (argv) => {
+    const args = { port: 9500, http: 9501, simulate: 0 };
+    for (let i = 0; i < argv.length; i += 2) {
+        const key = argv[i].replace(/^--/, '');
+        if (!(key in args)) {
+            console.error(`Tuntematon valitsin: ${argv[i]}`);
+            process.exit(1);
+        }
+        args[key] = Number(argv[i + 1]);
+    }
+    return args;
+};
+
+// Jäsentää QDataStreamin big-endian-kehyksen; virheellinen kehys palauttaa null
+const parseFrame = (buffer) => {
+    if (buffer.length < 9 || buffer.toString('latin1', 0, 4) !== 'ATMT' || buffer[4] !== FRAME_VERSION) return null;
+    let offset = 5;
+    const readBytes = () => {
+        const length = buffer.readUInt32BE(offset);
+        offset += 4;
+        if (length === 0xffffffff) return '';
+        const value = buffer.toString('utf8', offset, offset + length);
+        offset += length;
+        return value;
+    };
+    try {
+        const atm = readBytes();
+        const timestamp = Number(buffer.readBigInt64BE(offset));
+        const sequence = buffer.readUInt32BE(offset + 8);
+        const count = buffer.readUInt16BE(offset + 12);
+        offset += 14;
+        const values = {};
+        for (let i = 0; i < count; i++) {
+            const name = readBytes();
+            values[name] = Number(buffer.readBigInt64BE(offset));
+            offset += 8;
+        }
+        return { atm, timestamp, sequence, values };
+    } catch (error) {
+        return null;
+    }
+};
+
+// Yhden automaatin ämpärirenkaat; ämpärin aikaleima kertoo, onko paikka ajan tasalla
+class AtmSeries {
+    constructor(id) {
+        this.id = id;
+        this.fine = new Float64Array(FINE_SLOTS * FIELDS);
+        this.fineStart = new Float64Array(FINE_SLOTS);
+        this.coarse = new Float64Array(COARSE_SLOTS * FIELDS);
+        this.coarseStart = new Float64Array(COARSE_SLOTS);
+        this.latest = {};
+        this.lastSeen = 0;
+        this.lastSequence = 0;
+        this.lostFrames = 0;
+    }
+
+    add(frame, now) {
+        if (this.lastSequence && frame.sequence > this.lastSequence + 1) {
+            this.lostFrames += frame.sequence - this.lastSequence - 1;
+        }
+        this.lastSequence = frame.sequence;
+        this.lastSeen = now;
+        this.latest = frame.values;
+
+        const requests = frame.values.interval_requests || 0;
+        const latencyUs = (frame.values.avg_latency_us || 0) * requests;
+        this.addTo(this.fine, this.fineStart, FINE_SLOTS, FINE_MS, now, requests, frame.values.interval_errors || 0, latencyUs, frame.values.rss_kb || 0);
+        this.addTo(this.coarse, this.coarseStart, COARSE_SLOTS, COARSE_MS, now, requests, frame.values.interval_errors || 0, latencyUs, frame.values.rss_kb || 0);
+    }
+
+    // Karkeat ämpärit päivitetään samalla kertaa, joten alasnäytteistys ei vaadi erillistä ajoa
+    addTo(data, starts, slots, widthMs, now, requests, errors, latencyUs, rssKb) {
+        const start = now - (now % widthMs);
+        const slot = Math.floor(now / widthMs) % slots;
+        const base = slot * FIELDS;
+        if (starts[slot] !== start) {
+            starts[slot] = start;
+            data.fill(0, base, base + FIELDS);
+        }
+        data[base + REQUESTS] += requests;
+        data[base + ERRORS] += errors;
+        data[base + LATENCY_US] += latencyUs;
+        data[base + RSS_KB] = rssKb;
+    }
+
+    // Summat ikkunasta: lyhyet ikkunat tarkoista ämpäreistä, pidemmät karkeista
+    summarize(windowMs, now) {
+        const fine = windowMs <= FINE_MS * FINE_SLOTS;
+        const data = fine ? this.fine : this.coarse;
+        const starts = fine ? this.fineStart : this.coarseStart;
+        const widthMs = fine ? FINE_MS : COARSE_MS;
+        const oldest = now - windowMs - widthMs;
+        const current = Math.floor(now / widthMs);
+        const span = Math.min(starts.length, Math.ceil(windowMs / widthMs) + 1);
+        let requests = 0;
+        let errors = 0;
+        let latencyUs = 0;
+        // Käydään läpi vain ikkunaan osuvat paikat uusimmasta taaksepäin
+        for (let back = 0; back < span; back++) {
+            const slot = (current - back) % starts.length;
+            if (starts[slot] <= oldest || starts[slot] === 0) continue;
+            const base = slot * FIELDS;
+            requests += data[base + REQUESTS];
+            errors += data[base + ERRORS];
+            latencyUs += data[base + LATENCY_US];
+        }
+        return { requests, errors, avgLatencyUs: requests > 0 ? latencyUs / requests : 0 };
+    }
+}
+
+class TelemetryStore {
+    constructor() {
+        this.atms = new Map();
+        this.frames = 0;
+        this.rejected = 0;
+    }
+
+    ingest(buffer, now = Date.now()) {
+        const frame = parseFrame(buffer);
+        if (!frame || !frame.atm) {
+            this.rejected++;
+            return;
+        }
+        let series = this.atms.get(frame.atm);
+        if (!series) {
+            series = new AtmSeries(frame.atm);
+            this.atms.set(frame.atm, series);
+        }
+        series.add(frame, now);
+        this.frames++;
+    }
+
+    // n hitainta: pidetään pientä järjestettyä listaa koko lajittelun sijaan
+    top(windowMs, n, now = Date.now()) {
+        const best = [];
+        for (const series of this.atms.values()) {
+            if (now - series.lastSeen > windowMs) continue;
+            const summary = series.summarize(windowMs, now);
+            if (summary.requests === 0) continue;
+            if (best.length === n && summary.avgLatencyUs <= best[n - 1].avgLatencyUs) continue;
+            const entry = {
+                atm: series.id,
+                avgLatencyUs: Math.round(summary.avgLatencyUs),
+                requests: summary.requests,
+                errors: summary.errors,
+                readerState: series.latest.reader_state || 0,
+                rssKb: series.latest.rss_kb || 0
+            };
+            let position = best.length;
+            while (position > 0 && best[position - 1].avgLatencyUs < entry.avgLatencyUs) position--;
+            best.splice(position, 0, entry);
+            if (best.length > n) best.pop();
+        }
+        return best;
+    }
+
+    describe(id, now = Date.now()) {
+        const series = this.atms.get(id);
+        if (!series) return null;
+        return {
+            atm: id,
+            lastSeenMsAgo: now - series.lastSeen,
+            lostFrames: series.lostFrames,
+            latest: series.latest,
+            last5min: series.summarize(COARSE_MS, now),
+            last24h: series.summarize(COARSE_MS * COARSE_SLOTS, now)
+        };
+    }
+}
+
+const createHttpServer = (store) => http.createServer((req, res) => {
+    const url = new URL(req.url, 'http://localhost');
+    let body = null;
+    if (url.pathname === '/top') {
+        const windowS = Number(url.searchParams.get('window')) || 300;
+        const n = Math.min(Number(url.searchParams.get('n')) || 10, 1000);
+        body = { window: windowS, atms: store.atms.size, top: store.top(windowS * 1000, n) };
+    } else if (url.pathname.startsWith('/atm/')) {
+        body = store.describe(decodeURIComponent(url.pathname.slice(5)));
+    }
+    if (!body) {
+        res.writeHead(404, { 'Content-Type': 'application/json' });
+        return res.end(JSON.stringify({ error: 'Ei löytynyt' }));
+    }
+    res.writeHead(200, { 'Content-Type': 'application/json' });
+    res.end(JSON.stringify(body));
+});
+
+// Rakentaa samanlaisen kehyksen kuin TelemetryReporter
+const encodeFrame = (atm, timestamp, sequence, values) => {
+    const entries = Object.entries(values);
+    const parts = [Buffer.from('ATMT'), Buffer.from([FRAME_VERSION])];
+    const pushBytes = (text) => {
+        const bytes = Buffer.from(text);
+        const length = Buffer.alloc(4);
+        length.writeUInt32BE(bytes.length);
+        parts.push(length, bytes);
+    };
+    pushBytes(atm);
+    const header = Buffer.alloc(14);
+    header.writeBigInt64BE(BigInt(timestamp));
+    header.writeUInt32BE(sequence, 8);
+    header.writeUInt16BE(entries.length, 12);
+    parts.push(header);
+    for (const [name, value] of entries) {
+        pushBytes(name);
+        const number = Buffer.alloc(8);
+        number.writeBigInt64BE(BigInt(value));
+        parts.push(number);
+    }
+    return Buffer.concat(parts);
+};
+
+// Paikallinen testi: simuloidut automaatit lähettävät kehyksiä oikean UDP-pistokkeen kautta,
+// joista joka sadas on hidas. Lopuksi tarkistetaan, että /top löytää juuri ne.
+const simulate = async (store, args) => {
+    const client = dgram.createSocket('udp4');
+    const slow = new Set();
+    const rounds = 30;
+    const sendStarted = process.hrtime.bigint();
+    for (let round = 0; round < rounds; round++) {
+        for (let i = 0; i < args.simulate; i++) {
+            const atm = `atm-${i}`;
+            const isSlow = i % 100 === 7;
+            if (isSlow) slow.add(atm);
+            const frame = encodeFrame(atm, Date.now(), round + 1, {
+                interval_requests: 5 + (i % 7),
+                interval_errors: isSlow ? 2 : 0,
+                avg_latency_us: isSlow ? 900000 + i : 20000 + (i % 5000),
+                rss_kb: 60000 + (i % 1000),
+                reader_state: 1,
+                requests_in_flight: 0,
+                requests_queued: 0
+            });
+            await new Promise((resolve) => client.send(frame, args.port, '127.0.0.1', resolve));
+            // Sama prosessi vastaanottaa, joten annetaan silmukan tyhjentää pistokkeen puskuri
+            if (i % 100 === 99) await new Promise((resolve) => setTimeout(resolve, 1));
+        }
+    }
+    const sendS = Number(process.hrtime.bigint() - sendStarted) / 1e9;
+    client.close();
+    await new Promise((resolve) => setTimeout(resolve, 200));
+
+    const queryStarted = process.hrtime.bigint();
+    const top = store.top(300 * 1000, slow.size);
+    const queryMs = Number(process.hrtime.bigint() - queryStarted) / 1e6;
+
+    const expected = args.simulate * rounds;
+    console.log(`kehyksiä            ${store.frames} / ${expected} vastaanotettu (${Math.round(store.frames / sendS)} kehystä/s)`);
+    console.log(`automaatteja        ${store.atms.size}`);
+    console.log(`/top-kysely         ${queryMs.toFixed(2)} ms`);
+    console.log(`keko                ${(process.memoryUsage().heapUsed / 1024 / 1024).toFixed(1)} MiB`);
+    const found = top.filter((entry) => slow.has(entry.atm)).length;
+    console.log(`hitaat löydetty     ${found} / ${slow.size}`);
+    if (found !== slow.size) process.exitCode = 1;
+};
+
+const main = async () => {
+    const args = parseArgs(process.argv.slice(2));
+    const store = new TelemetryStore();
+
+    const socket = dgram.createSocket('udp4');
+    socket.on('message', (message) => store.ingest(message));
+    await new Promise((resolve) => socket.bind(args.port, resolve));
+    try {
+        socket.setRecvBufferSize(4 * 1024 * 1024);
+    } catch (error) {
+        console.error('Vastaanottopuskurin kasvatus epäonnistui:', error.message);
+    }
+
+    if (args.simulate > 0) {
+        await simulate(store, args);
+        socket.close();
+        return;
+    }
+
+    createHttpServer(store).listen(args.http);
+    console.log(`Telemetria UDP ${args.port}, HTTP ${args.http}`);
+};
+
+if (require.main === module) {
+    main().catch((error) => {
+        console.error(error);
+        process.exit(1);
+    });
+}
+
+module.exports = { parseFrame, encodeFrame, TelemetryStore };
@@ -0,0 +1,70 @@
+#!/usr/bin/env node
+// Nopeustarkistuksen läpäisykykymittaus: syöttää synteettisiä nostotapahtumia
+// (assess + record) simuloidulla kellolla ja raportoi tapahtumat/s sekä arvioinnin viiveen.
+//
+// Käyttö:
+//   node tools/velocity_bench.js --events 1000000 --rate 100000 --cards 50000 --atms 500
+
+const velocity = require('../velocity');
+
+const parseArgs = (argv) => {
+    const args = { events: 1000000, rate: 100000, cards: 50000, atms: 500 };
+    for (let i = 0; i < argv.length; i += 2) {
+        const key = argv[i].replace(/^--/, '');
+        if (!(key in args)) {
+            console.error(`Tuntematon valitsin: ${argv[i]}`);
+            process.exit(1);
+        }
+        args[key] = Number(argv[i + 1]);
+    }
+    return args;
+};
+
+const percentile = (sorted, p) => sorted[Math.min(sorted.length - 1, Math.floor(sorted.length * p))];
+
+const main = () => {
+    const args = parseArgs(process.argv.slice(2));
+
+    // Simuloitu kello etenee tavoitetahdin mukaan, joten ikkunat täyttyvät kuin tuotannossa
+    const startTime = Date.now();
+    const stepMs = 1000 / args.rate;
+    const samples = new Float64Array(Math.min(args.events, 100000));
+    let denied = 0;
+
+    const started = process.hrtime.bigint();
+    for (let i = 0; i < args.events; i++) {
+        const card = (i * 7919) % args.cards;
+        const event = {
+            card,
+            account: card >> 1,
+            amount: 20 + (i % 10) * 10,
+            atm: `atm-${(i * 31) % args.atms}`,
+            time: startTime + i * stepMs
+        };
+
+        const sampled = i % Math.ceil(args.events / samples.length) === 0;
+        const before = sampled ? process.hrtime.bigint() : 0n;
+        const risk = velocity.assess(event);
+        if (sampled) {
+            samples[Math.floor(i / Math.ceil(args.events / samples.length))] = Number(process.hrtime.bigint() - before) / 1000;
+        }
+
+        if (risk.decision === 'deny') {
+            denied++;
+        } else {
+            velocity.record(event);
+        }
+    }
+    const elapsedS = Number(process.hrtime.bigint() - started) / 1e9;
+
+    const sorted = Array.from(samples).sort((a, b) => a - b);
+    const size = velocity.size();
+    console.log(`tapahtumia          ${args.events}`);
+    console.log(`läpäisy             ${Math.round(args.events / elapsedS)} tapahtumaa/s (tavoite ${args.rate})`);
+    console.log(`arviointi p50/p99   ${percentile(sorted, 0.5).toFixed(2)} / ${percentile(sorted, 0.99).toFixed(2)} µs`);
+    console.log(`hylätty             ${denied}`);
+    console.log(`avaimia             ${size.cards} korttia, ${size.accounts} tiliä`);
+    console.log(`keko                ${(process.memoryUsage().heapUsed / 1024 / 1024).toFixed(1)} MiB`);
+};
+
+main();
@@ -0,0 +1,33 @@
+const RING_SIZE = 4096;
+const ring = new Array(RING_SIZE);
+let head = 0;
+
+const epochOffsetUs = Date.now() * 1000 - Number(process.hrtime.bigint() / 1000n);
+const nowUs = () => Number(process.hrtime.bigint() / 1000n) + epochOffsetUs;
+
+// Kirjaa jokaisen X-Trace-Id-otsakkeellisen pyynnön spanin samaan aikakantaan
+// (µs epochista) kuin asiakas, jolloin molempien tiedostot voi yhdistää Chromessa
+const traceRequests = (req, res, next) => {
+    const traceId = req.headers['x-trace-id'];
+    if (!traceId) return next();
+
+    const startUs = nowUs();
+    res.on('finish', () => {
+        ring[head % RING_SIZE] = {
+            name: `${req.method} ${req.baseUrl}${req.path}`,
+            cat: 'backend',
+            ph: 'X',
+            ts: startUs,
+            dur: nowUs() - startUs,
+            pid: 'backend',
+            tid: process.pid,
+            args: { trace_id: traceId, status: res.statusCode }
+        };
+        head++;
+    });
+    next();
+};
+
+const traceEvents = (traceId) => ring.filter((event) => event && event.args.trace_id === traceId);
+
+module.exports = { traceRequests, traceEvents };
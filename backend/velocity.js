@@ -0,0 +1,204 @@
+// Nostojen nopeustarkistus: kortti- ja tilikohtaiset liukuvat ikkunat (1 min, 1 h, 24 h)
+// lohkorenkaina sekä eri automaattien määrä. Kaikki tila on muistissa, joten tarkistus
+// ei lisää tietokantakyselyitä /transactions/withdraw-polulle.
+
+const MINUTE = 60 * 1000;
+const HOUR = 60 * MINUTE;
+const DAY = 24 * HOUR;
+
+const limits = {
+    perMinuteCount: parseInt(process.env.VELOCITY_MAX_PER_MINUTE, 10) || 3,
+    hourlyAmount: parseFloat(process.env.VELOCITY_MAX_HOURLY_AMOUNT) || 2000,
+    dailyCount: parseInt(process.env.VELOCITY_MAX_DAILY_COUNT, 10) || 20,
+    atmsPerHour: parseInt(process.env.VELOCITY_MAX_ATMS_PER_HOUR, 10) || 3
+};
+
+// Ikkunat: [lohkojen määrä, lohkon pituus]
+const WINDOWS = [
+    [60, 1000],         // 1 min sekunnin lohkoina
+    [60, MINUTE],       // 1 h minuutin lohkoina
+    [96, 15 * MINUTE]   // 24 h vartin lohkoina
+];
+const SLOTS = WINDOWS.reduce((total, [buckets]) => total + buckets, 0);
+
+// Yhden avaimen (kortti tai tili) kaikki ikkunat yhtenäisissä taulukoissa
+class Aggregate {
+    constructor() {
+        this.counts = new Uint32Array(SLOTS);
+        this.sums = new Float64Array(SLOTS);
+        this.epochs = new Float64Array(SLOTS).fill(-1);
+        this.atms = new Map();
+        this.lastSeen = 0;
+    }
+
+    // Palauttaa automaatin edellisen käyttöajan, jotta kirjauksen voi perua (remove)
+    add(time, amount, atm) {
+        let previousSeen;
+        let base = 0;
+        for (const [buckets, width] of WINDOWS) {
+            const epoch = Math.floor(time / width);
+            const slot = base + (epoch % buckets);
+            if (this.epochs[slot] !== epoch) {
+                this.epochs[slot] = epoch;
+                this.counts[slot] = 0;
+                this.sums[slot] = 0;
+            }
+            this.counts[slot]++;
+            this.sums[slot] += amount;
+            base += buckets;
+        }
+
+        if (atm) {
+            previousSeen = this.atms.get(atm);
+            this.atms.delete(atm);
+            this.atms.set(atm, time);
+            // Map säilyttää lisäysjärjestyksen: vanhimmat ovat alussa
+            for (const [key, seen] of this.atms) {
+                if (time - seen <= DAY) break;
+                this.atms.delete(key);
+            }
+        }
+        this.lastSeen = time;
+        return previousSeen;
+    }
+
+    // Peruu add-kutsun. Palautettu automaatti siirtyy Mapin loppuun, joten se voi jäädä
+    // karsimatta vähän pidempään, mutta distinctAtms suodattaa ajan mukaan.
+    remove(time, amount, atm, previousSeen) {
+        let base = 0;
+        for (const [buckets, width] of WINDOWS) {
+            const epoch = Math.floor(time / width);
+            const slot = base + (epoch % buckets);
+            if (this.epochs[slot] === epoch && this.counts[slot] > 0) {
+                this.counts[slot]--;
+                this.sums[slot] = Math.max(0, this.sums[slot] - amount);
+            }
+            base += buckets;
+        }
+
+        if (atm && this.atms.get(atm) === time) {
+            if (previousSeen === undefined) {
+                this.atms.delete(atm);
+            } else {
+                this.atms.set(atm, previousSeen);
+            }
+        }
+    }
+
+    // Palauttaa { count, sum } ikkunalle (0 = minuutti, 1 = tunti, 2 = vuorokausi)
+    totals(window, time) {
+        let base = 0;
+        for (let i = 0; i < window; i++) base += WINDOWS[i][0];
+        const [buckets, width] = WINDOWS[window];
+        const oldest = Math.floor(time / width) - buckets;
+
+        let count = 0;
+        let sum = 0;
+        for (let slot = base; slot < base + buckets; slot++) {
+            if (this.epochs[slot] > oldest) {
+                count += this.counts[slot];
+                sum += this.sums[slot];
+            }
+        }
+        return { count, sum };
+    }
+
+    // Ikkunassa nähdyt automaatit; including lasketaan mukaan, ellei se ole jo ikkunassa
+    distinctAtms(time, span, including) {
+        let distinct = 0;
+        let includedInSpan = false;
+        for (const [atm, seen] of this.atms) {
+            if (time - seen <= span) {
+                distinct++;
+                if (atm === including) includedInSpan = true;
+            }
+        }
+        return including && !includedInSpan ? distinct + 1 : distinct;
+    }
+}
+
+const cards = new Map();
+const accounts = new Map();
+
+const aggregateFor = (map, key) => {
+    let aggregate = map.get(key);
+    if (!aggregate) {
+        aggregate = new Aggregate();
+        map.set(key, aggregate);
+    }
+    return aggregate;
+};
+
+// Arvioi noston ennen kirjausta. event: { card, account, amount, atm, time }
+const assess = (event) => {
+    const time = event.time || Date.now();
+    const reasons = [];
+    const card = cards.get(String(event.card));
+    const account = accounts.get(String(event.account));
+
+    if (card) {
+        if (card.totals(0, time).count + 1 > limits.perMinuteCount) {
+            reasons.push('card_per_minute_count');
+        }
+        if (card.totals(1, time).sum + event.amount > limits.hourlyAmount) {
+            reasons.push('card_hourly_amount');
+        }
+        if (card.distinctAtms(time, HOUR, event.atm) > limits.atmsPerHour) {
+            reasons.push('card_atms_per_hour');
+        }
+    } else if (event.amount > limits.hourlyAmount) {
+        reasons.push('card_hourly_amount');
+    }
+
+    if (account && account.totals(2, time).count + 1 > limits.dailyCount) {
+        reasons.push('account_daily_count');
+    }
+
+    return { decision: reasons.length > 0 ? 'deny' : 'allow', reasons };
+};
+
+// Kirjaa toteutuneen noston molempiin aggregaatteihin
+const record = (event) => {
+    const time = event.time || Date.now();
+    aggregateFor(cards, String(event.card)).add(time, event.amount, event.atm);
+    aggregateFor(accounts, String(event.account)).add(time, event.amount, event.atm);
+};
+
+// Arvioi noston ja kirjaa sen heti, jos se sallitaan, jotta samanaikaiset nostot näkevät
+// toisensa. Kuten limits.reserve: jos nosto ei toteudu, kirjaus perutaan release-kutsulla.
+const reserve = (event) => {
+    event.time = event.time || Date.now();
+    const risk = assess(event);
+    if (risk.decision === 'allow') {
+        event.previousAtmSeen = [
+            aggregateFor(cards, String(event.card)).add(event.time, event.amount, event.atm),
+            aggregateFor(accounts, String(event.account)).add(event.time, event.amount, event.atm)
+        ];
+    }
+    return risk;
+};
+
+const release = (event) => {
+    if (!event.previousAtmSeen) return;
+    const [cardSeen, accountSeen] = event.previousAtmSeen;
+    const card = cards.get(String(event.card));
+    const account = accounts.get(String(event.account));
+    if (card) card.remove(event.time, event.amount, event.atm, cardSeen);
+    if (account) account.remove(event.time, event.amount, event.atm, accountSeen);
+    event.previousAtmSeen = null;
+};
+
+// Poistaa yli vuorokauden käyttämättömät avaimet, jotta muisti ei kasva rajatta
+const sweep = (now = Date.now()) => {
+    for (const map of [cards, accounts]) {
+        for (const [key, aggregate] of map) {
+            if (now - aggregate.lastSeen > DAY) map.delete(key);
+        }
+    }
+};
+
+setInterval(sweep, 10 * MINUTE).unref();
+
+const size = () => ({ cards: cards.size, accounts: accounts.size });
+
+module.exports = { assess, record, reserve, release, sweep, size, limits };
@@ -1,11 +1,58 @@
+const crypto = require('crypto');
 const jwt = require('jsonwebtoken');
 
 const JWT_SECRET = '1234567890';
 
+// Tarkistettujen tokenien välimuisti: avaimena tokenin SHA-256-tiiviste, arvona purettu
+// sisältö ja vanhenemishetki. Sama token esitetään istunnon aikana jokaisessa pyynnössä,
+// joten toistuva tarkistus on pelkkä haku. Merkintä ei elä tokenin exp-hetkeä pidempään.
+const CACHE_MAX_ENTRIES = parseInt(process.env.TOKEN_CACHE_MAX_ENTRIES, 10) || 10000;
+const tokenCache = new Map();
+const signingKey = Buffer.from(JWT_SECRET);
+
+const digestOf = (token) => crypto.createHash('sha256').update(token).digest('base64');
+
+// HS256-tokenin tarkistus suoraan OpenSSL:n HMACilla; muut algoritmit jsonwebtokenille
+const verifyHs256 = (token) => {
+    const parts = token.split('.');
+    if (parts.length !== 3) throw new Error('jwt malformed');
+    const header = JSON.parse(Buffer.from(parts[0], 'base64url').toString());
+    if (header.alg !== 'HS256') return jwt.verify(token, JWT_SECRET);
+
+    const expected = crypto.createHmac('sha256', signingKey).update(`${parts[0]}.${parts[1]}`).digest();
+    const signature = Buffer.from(parts[2], 'base64url');
+    if (signature.length !== expected.length || !crypto.timingSafeEqual(signature, expected)) {
+        throw new Error('invalid signature');
+    }
+
+    const payload = JSON.parse(Buffer.from(parts[1], 'base64url').toString());
+    const now = Math.floor(Date.now() / 1000);
+    if (typeof payload.exp === 'number' && now >= payload.exp) throw new Error('jwt expired');
+    if (typeof payload.nbf === 'number' && now < payload.nbf) throw new Error('jwt not active');
+    return payload;
+};
+
+const verifyCached = (token) => {
+    const digest = digestOf(token);
+    const cached = tokenCache.get(digest);
+    if (cached) {
+        if (Date.now() < cached.expiresAt) return cached.decoded;
+        tokenCache.delete(digest);
+    }
+
+    const decoded = verifyHs256(token);
+    // Ilman exp-kenttää olevia tokeneita ei tallenneta, koska niiden elinikää ei tiedetä
+    if (typeof decoded.exp === 'number') {
+        if (tokenCache.size >= CACHE_MAX_ENTRIES) tokenCache.delete(tokenCache.keys().next().value);
+        tokenCache.set(digest, { decoded, expiresAt: decoded.exp * 1000 });
+    }
+    return decoded;
+};
+
 const verifyToken = (req, res, next) => {
     const authHeader = req.headers['authorization'];
-    const token = authHeader && authHeader.startsWith('Bearer ') 
-        ? authHeader.split(' ')[1] 
+    const token = authHeader && authHeader.startsWith('Bearer ')
+        ? authHeader.split(' ')[1]
         : (req.cookies ? req.cookies.token : null);
 
     if (!token) {
@@ -13,7 +60,7 @@ const verifyToken = (req, res, next) => {
     }
 
     try {
-        const decoded = jwt.verify(token, JWT_SECRET);
+        const decoded = verifyCached(token);
         req.user = decoded;
         next();
     } catch (error) {
@@ -22,4 +69,4 @@ const verifyToken = (req, res, next) => {
     }
 };
 
-module.exports = { verifyToken };
\ No newline at end of file
+module.exports = { verifyToken, verifyCached, verifyHs256 };
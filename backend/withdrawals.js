@@ -0,0 +1,152 @@
+// Nostojen viitekirjanpito peruutuksia varten. Asiakas antaa jokaiselle nostolle viitteen
+// (istunnon jäljitystunniste + satunnainen loppuosa), ja peruutus tehdään viitteen mukaan.
+//
+// Tila kulkee pending -> committing -> committed -> reversing -> reversed. Peruutus, joka ehtii
+// ennen commitia (asiakkaan aikaraja ylittyi), jättää viitteelle tilan void, jolloin nosto
+// perutaan ennen commitia eikä myöhässä saapuva nosto enää kirjaudu. Kirjatut, perutut ja
+// mitätöidyt viitteet tallennetaan levylle heti, jotta toistettu peruutus on idempotentti
+// myös prosessin uudelleenkäynnistyksen yli.
+
+const fs = require('fs');
+
+const CHECKPOINT_FILE = process.env.WITHDRAWALS_CHECKPOINT_FILE || 'withdrawals-checkpoint.json';
+const RETENTION_MS = parseInt(process.env.WITHDRAWALS_RETENTION_MS, 10) || 2 * 24 * 60 * 60 * 1000;
+
+// Levylle tallennettavat tilat; keskeneräiset nostot katoavat prosessin mukana (kanta perii ne)
+const DURABLE = new Set(['committed', 'reversed', 'void']);
+
+const entries = new Map();
+let dirty = false;
+let scheduled = false;
+
+const checkpoint = () => {
+    scheduled = false;
+    if (!dirty) return;
+    const cutoff = Date.now() - RETENTION_MS;
+    const saved = [];
+    for (const [reference, entry] of entries) {
+        if (entry.updatedAt < cutoff) {
+            entries.delete(reference);
+            continue;
+        }
+        if (!DURABLE.has(entry.state) && entry.state !== 'reversing') continue;
+        // Kesken jäänyt peruutus tallennetaan kirjattuna, jolloin asiakkaan uusintayritys tekee sen
+        saved.push([reference, entry.state === 'reversing' ? 'committed' : entry.state, entry.account, entry.card,
+            entry.amount, entry.transactionId || null, entry.reversalId || null, entry.updatedAt]);
+    }
+    const temporary = `${CHECKPOINT_FILE}.tmp`;
+    try {
+        fs.writeFileSync(temporary, JSON.stringify(saved));
+        fs.renameSync(temporary, CHECKPOINT_FILE);
+        dirty = false;
+    } catch (error) {
+        console.error('Nostoviitteiden tallennus epaonnistui:', error.message);
+    }
+};
+
+// Tallennus kootaan tapahtumasilmukan kierroksen loppuun, ettei jokainen muutos kirjoita erikseen
+const persist = () => {
+    dirty = true;
+    if (scheduled) return;
+    scheduled = true;
+    setImmediate(checkpoint);
+};
+
+const restore = () => {
+    try {
+        const saved = JSON.parse(fs.readFileSync(CHECKPOINT_FILE, 'utf8'));
+        for (const [reference, state, account, card, amount, transactionId, reversalId, updatedAt] of saved) {
+            entries.set(reference, { state, account, card, amount, transactionId, reversalId, updatedAt, velocity: null });
+        }
+    } catch (error) {
+        if (error.code !== 'ENOENT') {
+            console.error('Nostoviitteiden lataus epaonnistui:', error.message);
+        }
+    }
+};
+
+const transition = (entry, state) => {
+    entry.state = state;
+    entry.updatedAt = Date.now();
+    if (DURABLE.has(state)) persist();
+};
+
+// Nosto alkaa. False, jos viite on jo käytetty tai peruutus on jo mitätöinyt sen.
+const begin = (reference, account, card, amount, velocityEvent) => {
+    if (entries.has(reference)) return false;
+    entries.set(reference, {
+        state: 'pending', account, card, amount, transactionId: null, reversalId: null,
+        updatedAt: Date.now(), velocity: velocityEvent
+    });
+    return true;
+};
+
+// Juuri ennen commitia. False, jos peruutus on ehtinyt mitätöidä noston.
+const beginCommit = (reference) => {
+    const entry = entries.get(reference);
+    if (!entry || entry.state !== 'pending') return false;
+    transition(entry, 'committing');
+    return true;
+};
+
+const committed = (reference, transactionId) => {
+    const entry = entries.get(reference);
+    if (!entry) return;
+    entry.transactionId = transactionId;
+    transition(entry, 'committed');
+};
+
+// Nosto ei toteutunut: viite vapautuu. Mitätöinti jää voimaan.
+const abandon = (reference) => {
+    const entry = entries.get(reference);
+    if (entry && (entry.state === 'pending' || entry.state === 'committing')) {
+        entries.delete(reference);
+    }
+};
+
+// Varaa peruutuksen tilille `account`. Palauttaa { status, entry }:
+//   claimed   - peruutus tehdään nyt (kutsujan on kutsuttava reversed tai reversalFailed)
+//   reversed  - jo peruttu aiemmin
+//   void      - nostoa ei kirjattu, eikä sitä enää kirjata
+//   busy      - nosto tai peruutus on kesken, yritä uudelleen
+//   forbidden - viite kuuluu toiselle tilille
+const claimReversal = (reference, account) => {
+    let entry = entries.get(reference);
+    if (!entry) {
+        entry = { state: 'pending', account, card: null, amount: 0, transactionId: null, reversalId: null, updatedAt: Date.now(), velocity: null };
+        entries.set(reference, entry);
+    }
+    if (Number(entry.account) !== Number(account)) return { status: 'forbidden', entry: null };
+
+    switch (entry.state) {
+    case 'pending':
+        transition(entry, 'void');
+        return { status: 'void', entry };
+    case 'committed':
+        transition(entry, 'reversing');
+        return { status: 'claimed', entry };
+    case 'reversed':
+    case 'void':
+        return { status: entry.state, entry };
+    default:
+        return { status: 'busy', entry };
+    }
+};
+
+const reversed = (reference, reversalId) => {
+    const entry = entries.get(reference);
+    if (!entry) return;
+    entry.reversalId = reversalId;
+    entry.velocity = null;
+    transition(entry, 'reversed');
+};
+
+const reversalFailed = (reference) => {
+    const entry = entries.get(reference);
+    if (entry && entry.state === 'reversing') transition(entry, 'committed');
+};
+
+restore();
+process.once('beforeExit', checkpoint);
+
+module.exports = { begin, beginCommit, committed, abandon, claimReversal, reversed, reversalFailed, checkpoint };
@@ -0,0 +1,205 @@
+#include "asynclogger.h"
+#include "clientmetrics.h"
+#include <QDateTime>
+#include <QDir>
+#include <QRegularExpression>
+#include <cstdio>
+
+Q_LOGGING_CATEGORY(lcNetwork, "atm.network")
+Q_LOGGING_CATEGORY(lcCard, "atm.card")
+Q_LOGGING_CATEGORY(lcUi, "atm.ui")
+
+AsyncLogger *AsyncLogger::instance = nullptr;
+
+AsyncLogger::AsyncLogger()
+    : ring(new Slot[Capacity]), enqueuePos(0), dequeuePos(0), dropped(0), stopping(false), previousHandler(nullptr)
+{
+    for (quint64 i = 0; i < Capacity; ++i) {
+        ring[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    QString directory = QString::fromLocal8Bit(qgetenv("ATM_LOG_DIR"));
+    if (!directory.isEmpty()) {
+        QDir().mkpath(directory);
+        logPath = QDir(directory).filePath("atm.log");
+    }
+}
+
+AsyncLogger::~AsyncLogger()
+{
+    if (instance == this) {
+        qInstallMessageHandler(previousHandler);
+        instance = nullptr;
+    }
+
+    // Taustasäie tyhjentää puskurin ennen lopettamista
+    stopping.store(true);
+    if (writerThread) {
+        writerThread->wait();
+        delete writerThread;
+    }
+    delete[] ring;
+}
+
+void AsyncLogger::start()
+{
+    if (!logPath.isEmpty()) {
+        file.setFileName(logPath);
+        file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text);
+    }
+
+    // Verkkoliikenteen debug-viestit ovat oletuksena pois; QT_LOGGING_RULES ohittaa tämän
+    QLoggingCategory::setFilterRules("atm.network.debug=false");
+
+    writerThread = QThread::create([this]() {
+        writerLoop();
+    });
+    writerThread->start(QThread::LowPriority);
+
+    instance = this;
+    previousHandler = qInstallMessageHandler(messageHandler);
+}
+
+QString AsyncLogger::redact(const QString &message)
+{
+    // Lainausmerkit voivat olla escapoituja (\"pin_code\": \"1234\"), kun QDebug tulostaa
+    // QByteArrayn tai QStringin lainattuna
+    static const QRegularExpression pinPattern("(\\\\?\"?pin_code\\\\?\"?\\s*[:=]\\s*\\\\?\"?)\\d+");
+    static const QRegularExpression cardPattern("(\\\\?\")(\\d{4,15})(\\d{4})(\\\\?\")");
+
+    QString text = message;
+    text.replace(pinPattern, "\\1****");
+
+    QString masked;
+    int copied = 0;
+    QRegularExpressionMatchIterator it = cardPattern.globalMatch(text);
+    while (it.hasNext()) {
+        QRegularExpressionMatch match = it.next();
+        masked += text.mid(copied, match.capturedStart(0) - copied);
+        masked += match.captured(1) + QString(match.capturedLength(2), '*') + match.captured(3) + match.captured(4);
+        copied = match.capturedEnd(0);
+    }
+    masked += text.mid(copied);
+    return masked;
+}
+
+void AsyncLogger::messageHandler(QtMsgType type, const QMessageLogContext &context, const QString &message)
+{
+    AsyncLogger *logger = instance;
+    if (!logger || type == QtFatalMsg) {
+        // Kaatuva viesti kirjoitetaan heti, koska Qt keskeyttää prosessin käsittelijän jälkeen
+        fprintf(stderr, "%s\n", qPrintable(redact(message)));
+        fflush(stderr);
+        return;
+    }
+
+    LogRecord record;
+    record.type = type;
+    record.category = context.category ? context.category : "default";
+    record.timestampMs = QDateTime::currentMSecsSinceEpoch();
+    record.message = message;
+    if (!logger->tryPush(record)) {
+        logger->dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+// Rajattu monen kirjoittajan ja yhden lukijan jono (Vyukov): ei lukkoja eikä varauksia
+bool AsyncLogger::tryPush(LogRecord &record)
+{
+    quint64 pos = enqueuePos.load(std::memory_order_relaxed);
+    for (;;) {
+        Slot &slot = ring[pos & (Capacity - 1)];
+        quint64 sequence = slot.sequence.load(std::memory_order_acquire);
+        qint64 diff = static_cast<qint64>(sequence) - static_cast<qint64>(pos);
+        if (diff == 0) {
+            if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                slot.record = std::move(record);
+                slot.sequence.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (diff < 0) {
+            return false; // Puskuri täynnä
+        } else {
+            pos = enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+bool AsyncLogger::tryPop(LogRecord &record)
+{
+    quint64 pos = dequeuePos.load(std::memory_order_relaxed);
+    Slot &slot = ring[pos & (Capacity - 1)];
+    quint64 sequence = slot.sequence.load(std::memory_order_acquire);
+    if (static_cast<qint64>(sequence) - static_cast<qint64>(pos + 1) < 0) {
+        return false;
+    }
+    record = std::move(slot.record);
+    slot.sequence.store(pos + Capacity, std::memory_order_release);
+    dequeuePos.store(pos + 1, std::memory_order_relaxed);
+    return true;
+}
+
+void AsyncLogger::writerLoop()
+{
+    LogRecord record;
+    for (;;) {
+        bool wrote = false;
+        while (tryPop(record)) {
+            write(record);
+            wrote = true;
+        }
+
+        quint64 lost = dropped.exchange(0, std::memory_order_relaxed);
+        if (lost > 0) {
+            ClientMetrics::increment("log_dropped", lost);
+        }
+
+        if (wrote) {
+            if (file.isOpen()) {
+                file.flush();
+                rotateIfNeeded();
+            } else {
+                fflush(stderr);
+            }
+        } else if (stopping.load()) {
+            return;
+        } else {
+            QThread::msleep(5);
+        }
+    }
+}
+
+void AsyncLogger::write(const LogRecord &record)
+{
+    static const char levels[] = { 'D', 'W', 'C', 'F', 'I' };
+    QByteArray line = QDateTime::fromMSecsSinceEpoch(record.timestampMs).toString(Qt::ISODateWithMs).toUtf8();
+    line += ' ';
+    line += levels[record.type];
+    line += ' ';
+    line += record.category;
+    line += ": ";
+    line += redact(record.message).toUtf8();
+    line += '\n';
+
+    if (file.isOpen()) {
+        file.write(line);
+    } else {
+        fwrite(line.constData(), 1, line.size(), stderr);
+    }
+}
+
+void AsyncLogger::rotateIfNeeded()
+{
+    if (file.size() < MaxFileSize) {
+        return;
+    }
+
+    // atm.log -> atm.log.1 -> ... -> atm.log.<KeptFiles>
+    file.close();
+    QFile::remove(logPath + "." + QString::number(KeptFiles));
+    for (int i = KeptFiles - 1; i >= 1; --i) {
+        QFile::rename(logPath + "." + QString::number(i), logPath + "." + QString::number(i + 1));
+    }
+    QFile::rename(logPath, logPath + ".1");
+    file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text);
+}
@@ -0,0 +1,69 @@
+#ifndef ASYNCLOGGER_H
+#define ASYNCLOGGER_H
+
+#include <QFile>
+#include <QLoggingCategory>
+#include <QPointer>
+#include <QString>
+#include <QThread>
+#include <atomic>
+
+// Lokikategoriat; tasot säädetään QT_LOGGING_RULES-muuttujalla, esim.
+// QT_LOGGING_RULES="atm.network.debug=true;atm.card.debug=false"
+Q_DECLARE_LOGGING_CATEGORY(lcNetwork)
+Q_DECLARE_LOGGING_CATEGORY(lcCard)
+Q_DECLARE_LOGGING_CATEGORY(lcUi)
+
+// Asynkroninen lokittaja: Qt:n viestinkäsittelijä siirtää viestit lukottomaan
+// rengaspuskuriin, ja taustasäie muotoilee, peittää arkaluontoiset kentät ja
+// kirjoittaa ne kiertäviin tiedostoihin (ATM_LOG_DIR) tai stderr:iin.
+class AsyncLogger
+{
+public:
+    AsyncLogger();
+    ~AsyncLogger();
+
+    void start();
+
+    // Peittää PIN-koodit kokonaan ja korttinumeroista kaikki paitsi 4 viimeistä numeroa
+    static QString redact(const QString &message);
+
+private:
+    struct LogRecord
+    {
+        QtMsgType type;
+        const char *category;
+        qint64 timestampMs;
+        QString message;
+    };
+
+    struct Slot
+    {
+        std::atomic<quint64> sequence;
+        LogRecord record;
+    };
+
+    static void messageHandler(QtMsgType type, const QMessageLogContext &context, const QString &message);
+    bool tryPush(LogRecord &record);
+    bool tryPop(LogRecord &record);
+    void writerLoop();
+    void write(const LogRecord &record);
+    void rotateIfNeeded();
+
+    static const quint64 Capacity = 4096;
+    static const qint64 MaxFileSize = 5 * 1024 * 1024;
+    static const int KeptFiles = 3;
+    static AsyncLogger *instance;
+
+    Slot *ring;
+    std::atomic<quint64> enqueuePos;
+    std::atomic<quint64> dequeuePos;
+    std::atomic<quint64> dropped;
+    std::atomic<bool> stopping;
+    QPointer<QThread> writerThread;
+    QtMessageHandler previousHandler;
+    QString logPath;
+    QFile file;
+};
+
+#endif // ASYNCLOGGER_H
@@ -0,0 +1,86 @@
+#include "cashdispenser.h"
+#include <QtTest>
+
+// Mittaa seteliyhdistelmän haun ja taulukon rakentamisen eri kasettikokoonpanoilla
+class DispenserBench : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void buildTable_data();
+    void buildTable();
+    void plan_data();
+    void plan();
+    void planDepleted();
+};
+
+static void addConfigurations()
+{
+    QTest::addColumn<QVector<int>>("denominations");
+    QTest::newRow("50,20") << QVector<int>{ 50, 20 };
+    QTest::newRow("100,50,20") << QVector<int>{ 100, 50, 20 };
+    QTest::newRow("100,50,20,10") << QVector<int>{ 100, 50, 20, 10 };
+}
+
+static CashDispenser filledDispenser(const QVector<int> &denominations, int notesPerCassette)
+{
+    CashDispenser dispenser(denominations);
+    for (int denomination : denominations) {
+        dispenser.setCount(denomination, notesPerCassette);
+    }
+    return dispenser;
+}
+
+void DispenserBench::buildTable_data()
+{
+    addConfigurations();
+}
+
+void DispenserBench::buildTable()
+{
+    QFETCH(QVector<int>, denominations);
+    QBENCHMARK {
+        CashDispenser dispenser(denominations);
+        Q_UNUSED(dispenser);
+    }
+}
+
+void DispenserBench::plan_data()
+{
+    addConfigurations();
+}
+
+void DispenserBench::plan()
+{
+    QFETCH(QVector<int>, denominations);
+    CashDispenser dispenser = filledDispenser(denominations, 500);
+
+    // Yksi kierros = haku jokaiselle summalle nostorajaan asti
+    QBENCHMARK {
+        int dispensable = 0;
+        for (int amount = 1; amount <= CashDispenser::MaxAmount; ++amount) {
+            dispensable += dispenser.canDispense(amount);
+        }
+        QVERIFY(dispensable > 0);
+    }
+}
+
+void DispenserBench::planDepleted()
+{
+    // Suurimmat kasetit tyhjinä: taulukon ehdokkaat eivät kelpaa ja haku tehdään varastosta
+    QVector<int> denominations{ 100, 50, 20, 10 };
+    CashDispenser dispenser = filledDispenser(denominations, 500);
+    dispenser.setCount(100, 0);
+    dispenser.setCount(50, 0);
+
+    QBENCHMARK {
+        int dispensable = 0;
+        for (int amount = 10; amount <= CashDispenser::MaxAmount; amount += 10) {
+            dispensable += dispenser.canDispense(amount);
+        }
+        QVERIFY(dispensable > 0);
+    }
+}
+
+QTEST_GUILESS_MAIN(DispenserBench)
+#include "bench_dispenser.moc"
@@ -0,0 +1,202 @@
+#include "replyformatter.h"
+#include <QtTest>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Laske kaikki kekovaraukset, jotta varaukset per operaatio voidaan raportoida
+static std::atomic<quint64> allocationCount(0);
+
+#if defined(__GLIBC__)
+// Qt:n säiliöt (QString, QByteArray, QJsonArray) varaavat datansa QArrayDatan kautta
+// suoraan malloc:lla eivätkä operator new:llä, joten laskenta tehdään malloc-tasolla.
+// Ohjelman omat määrittelyt peittävät glibc:n symbolit myös Qt-kirjastoille;
+// operator new kulkee samaa reittiä, joten sitä ei lasketa erikseen.
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+}
+
+static const char *const AllocationUnit = "allocations/op";
+#else
+// Muilla alustoilla lasketaan vain operator new -kutsut: Qt:n säiliöiden data jää pois,
+// joten luku on alaraja eikä kuvaa kaikkia varauksia
+void *operator new(std::size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void *ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+static const char *const AllocationUnit = "operator-new calls/op (Qt container data not counted)";
+#endif
+
+// Mittaa yhden ajon varaukset ja tulosta ne QBENCHMARK-tuloksen viereen
+template <typename Func>
+static void reportAllocations(const char *label, Func func)
+{
+    quint64 before = allocationCount.load(std::memory_order_relaxed);
+    func();
+    quint64 after = allocationCount.load(std::memory_order_relaxed);
+    qInfo("%s: %llu %s", label, static_cast<unsigned long long>(after - before), AllocationUnit);
+}
+
+static QByteArray historyPayload(int rows)
+{
+    QJsonArray transactions;
+    for (int i = 0; i < rows; ++i) {
+        QJsonObject tx;
+        tx["transaction_id"] = 100000 + i;
+        // DECIMAL-sarake tulee mysql2:lta merkkijonona
+        tx["summa"] = (i % 3 == 0) ? QStringLiteral("250.50") : QStringLiteral("-40.00");
+        tx["account_id"] = 42;
+        tx["transaction_time"] = QString("2025-03-%1T%2:15:30.000Z")
+                                     .arg(1 + i % 28, 2, 10, QLatin1Char('0'))
+                                     .arg(i % 24, 2, 10, QLatin1Char('0'));
+        transactions.append(tx);
+    }
+    return QJsonDocument(transactions).toJson(QJsonDocument::Compact);
+}
+
+class ReplyBench : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void authReply();
+    void withdrawalReply();
+    void topUpReply();
+    void balanceReply();
+    void historyReply_data();
+    void historyReply();
+    void transactionTime();
+};
+
+void ReplyBench::authReply()
+{
+    QByteArray payload = "{\"success\":true,\"customer\":{\"first_name\":\"Matti\",\"last_name\":\"Meikäläinen\"},"
+                         "\"account_id\":42,\"card_type\":\"credit\"}";
+    auto run = [&]() {
+        AuthReply auth = parseAuthReply(QJsonDocument::fromJson(payload).object());
+        QVERIFY(auth.valid);
+    };
+    reportAllocations("authReply", run);
+    QBENCHMARK {
+        run();
+    }
+}
+
+void ReplyBench::withdrawalReply()
+{
+    QByteArray payload = "{\"message\":\"Withdrawal successful\",\"transaction\":{\"amount\":40,\"new_balance\":1210.5}}";
+    auto run = [&]() {
+        bool success;
+        QString text = formatWithdrawalReply(QJsonDocument::fromJson(payload).object(), &success);
+        QVERIFY(success);
+    };
+    reportAllocations("withdrawalReply", run);
+    QBENCHMARK {
+        run();
+    }
+}
+
+void ReplyBench::topUpReply()
+{
+    QByteArray payload = "{\"success\":true,\"newBalance\":1250.5}";
+    auto run = [&]() {
+        bool success;
+        double newBalance;
+        QString text = formatTopUpReply(QJsonDocument::fromJson(payload).object(), &success, &newBalance);
+        QVERIFY(success);
+    };
+    reportAllocations("topUpReply", run);
+    QBENCHMARK {
+        run();
+    }
+}
+
+void ReplyBench::balanceReply()
+{
+    QByteArray payload = "{\"message\":\"Balance retrieved successfully\",\"balance\":-200.5,\"available\":799.5,\"card_type\":\"credit\"}";
+    auto run = [&]() {
+        QString text = formatBalanceReply(QJsonDocument::fromJson(payload).object());
+        QVERIFY(!text.isEmpty());
+    };
+    reportAllocations("balanceReply", run);
+    QBENCHMARK {
+        run();
+    }
+}
+
+void ReplyBench::historyReply_data()
+{
+    QTest::addColumn<int>("rows");
+    QTest::newRow("10") << 10;
+    QTest::newRow("100") << 100;
+    QTest::newRow("1000") << 1000;
+    QTest::newRow("10000") << 10000;
+}
+
+void ReplyBench::historyReply()
+{
+    QFETCH(int, rows);
+    QByteArray payload = historyPayload(rows);
+    auto run = [&]() {
+        QString text = formatHistoryReply(QJsonDocument::fromJson(payload));
+        QVERIFY(!text.isEmpty());
+    };
+    reportAllocations(qPrintable(QString("historyReply/%1").arg(rows)), run);
+    QBENCHMARK {
+        run();
+    }
+}
+
+void ReplyBench::transactionTime()
+{
+    QString isoTime("2025-03-20T10:15:30.000Z");
+    QCOMPARE(formatTransactionTime(isoTime),
+             QDateTime::fromString(isoTime, Qt::ISODate).toString("yyyy-MM-dd HH:mm:ss"));
+    reportAllocations("transactionTime", [&]() {
+        formatTransactionTime(isoTime);
+    });
+    QBENCHMARK {
+        formatTransactionTime(isoTime);
+    }
+}
+
+QTEST_GUILESS_MAIN(ReplyBench)
+#include "bench_replies.moc"
@@ -0,0 +1,140 @@
+#include "mainwindow.h"
+#include "terminalregistry.h"
+#include <QElapsedTimer>
+#include <QFile>
+#include <QtTest>
+#include <ctime>
+
+// Mittaa monipääteisännän kustannuksen: muisti ja CPU lisättyä päätettä kohden
+// verrattuna erillisen prosessin ensimmäiseen päätteeseen (= prosessi päätettä kohden).
+// Aja ilman näyttöä: bank_automat_bench_terminals -platform offscreen
+class TerminalsBench : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void cleanup();
+    void memoryPerTerminal_data();
+    void memoryPerTerminal();
+    void idleCpuPerTerminal();
+    void createTerminal();
+    void perTerminalState();
+
+private:
+    void spawn(int count);
+    static qint64 residentKb();
+    static double cpuMs();
+
+    QList<MainWindow*> terminals;
+};
+
+qint64 TerminalsBench::residentKb()
+{
+    QFile statm("/proc/self/statm");
+    if (!statm.open(QIODevice::ReadOnly)) {
+        return 0;
+    }
+    QList<QByteArray> fields = statm.readAll().split(' ');
+    return fields.size() > 1 ? fields.at(1).toLongLong() * 4 : 0;
+}
+
+double TerminalsBench::cpuMs()
+{
+    return 1000.0 * std::clock() / CLOCKS_PER_SEC;
+}
+
+void TerminalsBench::spawn(int count)
+{
+    for (int i = 0; i < count; ++i) {
+        MainWindow *terminal = new MainWindow(QString("T%1").arg(terminals.size()));
+        terminal->show();
+        terminals.append(terminal);
+    }
+    // Viivästetty alustus (lukija, yhteyden avaus) ja ensimmäinen piirto
+    for (int round = 0; round < 10; ++round) {
+        QCoreApplication::processEvents();
+        QTest::qWait(20);
+    }
+}
+
+void TerminalsBench::cleanup()
+{
+    qDeleteAll(terminals);
+    terminals.clear();
+}
+
+void TerminalsBench::memoryPerTerminal_data()
+{
+    QTest::addColumn<int>("count");
+    QTest::newRow("16") << 16;
+    QTest::newRow("64") << 64;
+}
+
+void TerminalsBench::memoryPerTerminal()
+{
+    QFETCH(int, count);
+    spawn(1);
+    qint64 firstKb = residentKb();
+    spawn(count - 1);
+    qint64 allKb = residentKb();
+
+    // Prosessi päätettä kohden maksaa koko prosessin muistin jokaisesta päätteestä
+    qint64 perAddedKb = (allKb - firstKb) / qMax(1, count - 1);
+    qInfo("%d päätettä: ensimmäinen %lld kt (prosessi ja pääte), lisätty pääte %lld kt, yhteensä %lld kt vs. %lld kt erillisinä prosesseina",
+          count, firstKb, perAddedKb, allKb, firstKb * count);
+    QCOMPARE(TerminalRegistry::count(), count);
+}
+
+void TerminalsBench::idleCpuPerTerminal()
+{
+    // Tyhjäkäynnin CPU (ajastimet, vahtikoira ei mukana) sekunnin jaksolla
+    spawn(1);
+    double before = cpuMs();
+    QTest::qWait(1000);
+    double single = cpuMs() - before;
+
+    spawn(63);
+    before = cpuMs();
+    QTest::qWait(1000);
+    double many = cpuMs() - before;
+
+    qInfo("Tyhjäkäynti: 1 pääte %.2f ms/s, 64 päätettä %.2f ms/s (%.3f ms/s lisättyä päätettä kohden)",
+          single, many, (many - single) / 63.0);
+}
+
+void TerminalsBench::createTerminal()
+{
+    // Päätteen luonti ja näyttäminen jaetulla verkkomanagerilla
+    QBENCHMARK {
+        MainWindow *terminal = new MainWindow(QString("T%1").arg(terminals.size()));
+        terminal->show();
+        QCoreApplication::processEvents();
+        terminals.append(terminal);
+    }
+}
+
+void TerminalsBench::perTerminalState()
+{
+    // Päätteillä on omat kasetit ja jäljitysistunnot
+    spawn(2);
+    MainWindow *first = terminals.at(0);
+    MainWindow *second = terminals.at(1);
+
+    first->sessionTrace().beginSession();
+    second->sessionTrace().beginSession();
+    QVERIFY(!first->sessionTrace().traceId().isEmpty());
+    QVERIFY(first->sessionTrace().traceId() != second->sessionTrace().traceId());
+    first->sessionTrace().endSession();
+    QVERIFY(first->sessionTrace().traceId().isEmpty());
+    QVERIFY(!second->sessionTrace().traceId().isEmpty());
+    second->sessionTrace().endSession();
+
+    CashDispenser &cash = first->cashDispenser();
+    int denomination = cash.denominations().first();
+    int before = second->cashDispenser().count(denomination);
+    QVERIFY(cash.dispense(cash.reserve(denomination)));
+    QCOMPARE(second->cashDispenser().count(denomination), before);
+}
+
+QTEST_MAIN(TerminalsBench)
+#include "bench_terminals.moc"
@@ -0,0 +1,124 @@
+#include "cashdispenser.h"
+#include <QtTest>
+
+// Käy läpi jokaisen summan 1..MaxAmount kullakin kasettikokoonpanolla ja vertaa
+// valittua yhdistelmää raa'an voiman hakuun
+class DispenserTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void everyAmount_data();
+    void everyAmount();
+    void reservation();
+};
+
+// Pienin setelimäärä, jolla summan voi antaa kasettien ja luukun rajoissa, -1 jos ei mitenkään
+static int fewestNotes(const QVector<int> &denominations, const QVector<int> &counts, int index, int amount, int notes)
+{
+    if (amount == 0) {
+        return notes;
+    }
+    if (index == denominations.size()) {
+        return -1;
+    }
+    int best = -1;
+    int most = qMin(counts[index], amount / denominations[index]);
+    for (int n = 0; n <= most && notes + n <= CashDispenser::MaxNotes; ++n) {
+        if (best >= 0 && notes + n >= best) {
+            break;
+        }
+        int found = fewestNotes(denominations, counts, index + 1, amount - n * denominations[index], notes + n);
+        if (found >= 0 && (best < 0 || found < best)) {
+            best = found;
+        }
+    }
+    return best;
+}
+
+void DispenserTest::everyAmount_data()
+{
+    // Nimellisarvot suurimmasta pienimpään ja kunkin kasetin setelimäärä
+    QTest::addColumn<QVector<int>>("denominations");
+    QTest::addColumn<QVector<int>>("counts");
+    QTest::newRow("50,20 full") << QVector<int>{ 50, 20 } << QVector<int>{ 200, 300 };
+    QTest::newRow("100,50,20 full") << QVector<int>{ 100, 50, 20 } << QVector<int>{ 100, 200, 300 };
+    QTest::newRow("100,50,20,10 full") << QVector<int>{ 100, 50, 20, 10 } << QVector<int>{ 100, 200, 300, 400 };
+    QTest::newRow("50,20 scarce") << QVector<int>{ 50, 20 } << QVector<int>{ 3, 4 };
+    QTest::newRow("50,20 no fifties") << QVector<int>{ 50, 20 } << QVector<int>{ 0, 300 };
+    QTest::newRow("100,50,20,10 large empty") << QVector<int>{ 100, 50, 20, 10 } << QVector<int>{ 0, 0, 500, 500 };
+    QTest::newRow("100,50,20,10 uneven") << QVector<int>{ 100, 50, 20, 10 } << QVector<int>{ 2, 1, 7, 3 };
+    QTest::newRow("empty") << QVector<int>{ 50, 20 } << QVector<int>{ 0, 0 };
+}
+
+void DispenserTest::everyAmount()
+{
+    QFETCH(QVector<int>, denominations);
+    QFETCH(QVector<int>, counts);
+
+    CashDispenser dispenser(denominations);
+    for (int i = 0; i < denominations.size(); ++i) {
+        dispenser.setCount(denominations[i], counts[i]);
+    }
+    QCOMPARE(dispenser.denominations(), denominations);
+
+    for (int amount = 1; amount <= CashDispenser::MaxAmount; ++amount) {
+        const QByteArray context = QByteArray("amount ") + QByteArray::number(amount);
+        CashDispenser::NoteMix mix = dispenser.plan(amount);
+        int expected = fewestNotes(denominations, counts, 0, amount, 0);
+
+        if (expected < 0) {
+            QVERIFY2(!mix.isValid(), context.constData());
+            QVERIFY2(!dispenser.canDispense(amount), context.constData());
+            continue;
+        }
+
+        QVERIFY2(mix.isValid(), context.constData());
+        int sum = 0;
+        int notes = 0;
+        for (int i = 0; i < denominations.size(); ++i) {
+            QVERIFY2(mix.counts[i] <= counts[i], context.constData());
+            sum += mix.counts[i] * denominations[i];
+            notes += mix.counts[i];
+        }
+        for (int i = denominations.size(); i < CashDispenser::MaxDenominations; ++i) {
+            QVERIFY2(mix.counts[i] == 0, context.constData());
+        }
+        QVERIFY2(sum == amount, context.constData());
+        QVERIFY2(notes == mix.notes, context.constData());
+        QVERIFY2(mix.notes == expected, context.constData());
+    }
+}
+
+void DispenserTest::reservation()
+{
+    CashDispenser dispenser(QVector<int>{ 50, 20 });
+    dispenser.setCount(50, 1);
+    dispenser.setCount(20, 3);
+
+    // Varattuja seteleitä ei luvata toiselle nostolle
+    CashDispenser::NoteMix first = dispenser.reserve(70);
+    QVERIFY(first.isValid());
+    QVERIFY(!dispenser.canDispense(50));
+    QVERIFY(dispenser.canDispense(40));
+
+    // Vapautus palauttaa setelit, anto vähentää ne kaseteista
+    dispenser.release(first);
+    QVERIFY(dispenser.canDispense(50));
+    CashDispenser::NoteMix second = dispenser.reserve(70);
+    QVERIFY(dispenser.dispense(second));
+    QCOMPARE(dispenser.count(50), 0);
+    QCOMPARE(dispenser.count(20), 2);
+
+    // Kasetti tyhjentynyt varauksen jälkeen: antoa ei tehdä ja varaus säilyy vapautettavaksi
+    CashDispenser::NoteMix third = dispenser.reserve(40);
+    QVERIFY(third.isValid());
+    dispenser.setCount(20, 1);
+    QVERIFY(!dispenser.dispense(third));
+    QCOMPARE(dispenser.count(20), 1);
+    dispenser.release(third);
+    QVERIFY(dispenser.canDispense(20));
+}
+
+QTEST_GUILESS_MAIN(DispenserTest)
+#include "test_dispenser.moc"
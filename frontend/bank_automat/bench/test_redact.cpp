@@ -0,0 +1,65 @@
+#include "asynclogger.h"
+#include <QtTest>
+#include <QDebug>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRegularExpression>
+
+// Tarkistaa, että lokin peitto toimii myös QDebugin escapoimassa muodossa
+class RedactTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void redact_data();
+    void redact();
+    void keepsOtherFields();
+};
+
+static QByteArray requestBody()
+{
+    QJsonObject json;
+    json["card_number"] = "1234567812345678";
+    json["pin_code"] = "1234";
+    json["amount"] = 40;
+    return QJsonDocument(json).toJson();
+}
+
+// Sama merkkijono, jonka qDebug() << data välittää viestinkäsittelijälle
+template <typename T>
+static QString debugForm(const T &value)
+{
+    QString text;
+    QDebug(&text) << "Pyynnön sisältö:" << value;
+    return text;
+}
+
+void RedactTest::redact_data()
+{
+    QTest::addColumn<QString>("message");
+    QTest::newRow("raw json") << QString::fromUtf8(requestBody());
+    QTest::newRow("compact json") << QString::fromUtf8(QJsonDocument::fromJson(requestBody()).toJson(QJsonDocument::Compact));
+    QTest::newRow("qdebug bytearray") << debugForm(requestBody());
+    QTest::newRow("qdebug string") << debugForm(QString::fromUtf8(requestBody()));
+    QTest::newRow("form field") << QString("pin_code=1234&card_number=\"1234567812345678\"");
+}
+
+void RedactTest::redact()
+{
+    QFETCH(QString, message);
+    QVERIFY2(message.contains("1234567812345678"), qPrintable(message));
+
+    QString redacted = AsyncLogger::redact(message);
+    QVERIFY2(!redacted.contains("1234567812345678"), qPrintable(redacted));
+    QVERIFY2(!redacted.contains(QRegularExpression("pin_code\\W*\\d")), qPrintable(redacted));
+    QVERIFY2(redacted.contains("5678"), qPrintable(redacted));
+}
+
+void RedactTest::keepsOtherFields()
+{
+    QString message = debugForm(QByteArray("{\"summa\": \"-40.00\", \"account_id\": 42, \"card_type\": \"credit\"}"));
+    QCOMPARE(AsyncLogger::redact(message), message);
+}
+
+QTEST_GUILESS_MAIN(RedactTest)
+#include "test_redact.moc"
@@ -0,0 +1,224 @@
+#include "cashdispenser.h"
+#include <QStringList>
+#include <algorithm>
+#include <climits>
+#include <functional>
+
+CashDispenser::CashDispenser(const QVector<int> &denominations)
+    : denoms(denominations)
+{
+    std::sort(denoms.begin(), denoms.end(), std::greater<int>());
+    if (denoms.size() > MaxDenominations) {
+        denoms.resize(MaxDenominations);
+    }
+    counts.fill(0, denoms.size());
+    reserved.fill(0, denoms.size());
+    buildTable();
+}
+
+CashDispenser CashDispenser::configured(const QString &readerId)
+{
+    QString config = QString::fromLocal8Bit(qgetenv(("ATM_CASSETTES_" + readerId).toLocal8Bit().constData()));
+    if (config.isEmpty()) {
+        config = QString::fromLocal8Bit(qgetenv("ATM_CASSETTES"));
+    }
+    if (config.isEmpty()) {
+        config = "50:200,20:300";
+    }
+
+    QVector<int> denominations;
+    QVector<QPair<int, int>> cassettes;
+    for (const QString &entry : config.split(',', Qt::SkipEmptyParts)) {
+        QStringList parts = entry.split(':');
+        int denomination = parts.value(0).trimmed().toInt();
+        if (denomination <= 0 || denominations.contains(denomination)) {
+            continue;
+        }
+        denominations.append(denomination);
+        cassettes.append(qMakePair(denomination, parts.value(1).trimmed().toInt()));
+    }
+
+    CashDispenser dispenser(denominations);
+    for (const auto &cassette : cassettes) {
+        dispenser.setCount(cassette.first, cassette.second);
+    }
+    return dispenser;
+}
+
+int CashDispenser::count(int denomination) const
+{
+    int index = denoms.indexOf(denomination);
+    return index >= 0 ? counts[index] : 0;
+}
+
+void CashDispenser::setCount(int denomination, int count)
+{
+    int index = denoms.indexOf(denomination);
+    if (index >= 0) {
+        counts[index] = qMax(0, count);
+    }
+}
+
+void CashDispenser::buildTable()
+{
+    table.clear();
+    table.resize(MaxAmount + 1);
+    if (denoms.isEmpty()) {
+        return;
+    }
+
+    // Käy läpi kaikki yhdistelmät, joissa on enintään MaxNotes seteliä ja summa <= MaxAmount
+    NoteMix mix;
+    mix.counts.fill(0);
+    mix.notes = 0;
+    std::function<void(int, int)> visit = [&](int index, int amount) {
+        if (index == denoms.size()) {
+            if (amount > 0) {
+                addCandidate(amount, mix);
+            }
+            return;
+        }
+        for (int n = 0; mix.notes + n <= MaxNotes && amount + n * denoms[index] <= MaxAmount; ++n) {
+            mix.counts[index] = n;
+            mix.notes += n;
+            visit(index + 1, amount + n * denoms[index]);
+            mix.notes -= n;
+        }
+        mix.counts[index] = 0;
+    };
+    visit(0, 0);
+}
+
+void CashDispenser::addCandidate(int amount, const NoteMix &mix)
+{
+    // Ehdokkaat pidetään setelimäärän mukaan järjestyksessä, vain MaxCandidates parasta
+    QVector<NoteMix> &candidates = table[amount];
+    if (candidates.size() == MaxCandidates && candidates.last().notes <= mix.notes) {
+        return;
+    }
+    auto position = std::upper_bound(candidates.begin(), candidates.end(), mix, [](const NoteMix &a, const NoteMix &b) {
+        return a.notes < b.notes;
+    });
+    candidates.insert(position, mix);
+    if (candidates.size() > MaxCandidates) {
+        candidates.removeLast();
+    }
+}
+
+// Tyhjimpään kasettiin varauksen jälkeen jäävät setelit, -1 jos jokin kasetti ei riitä
+int CashDispenser::score(const NoteMix &mix) const
+{
+    int lowest = INT_MAX;
+    for (int i = 0; i < denoms.size(); ++i) {
+        int remaining = counts[i] - reserved[i] - mix.counts[i];
+        if (remaining < 0) {
+            return -1;
+        }
+        lowest = qMin(lowest, remaining);
+    }
+    return lowest;
+}
+
+CashDispenser::NoteMix CashDispenser::plan(int amount) const
+{
+    NoteMix best;
+    best.counts.fill(0);
+    best.notes = 0;
+    if (amount <= 0 || amount > MaxAmount) {
+        return best;
+    }
+
+    // Samalla setelimäärällä valitaan yhdistelmä, joka jättää tyhjimpään kasettiin eniten seteleitä
+    int bestScore = -1;
+    for (const NoteMix &mix : table[amount]) {
+        if (best.isValid() && mix.notes > best.notes) {
+            break;
+        }
+        int mixScore = score(mix);
+        if (mixScore > bestScore) {
+            best = mix;
+            bestScore = mixScore;
+        }
+    }
+    if (best.isValid()) {
+        return best;
+    }
+
+    // Taulukon ehdokkaat eivät riitä (kasetteja tyhjentynyt): käydään läpi varaston rajoissa
+    // kaikki yhdistelmät ja valitaan samoin perustein, jotta setelimäärä on silti pienin
+    NoteMix mix;
+    mix.counts.fill(0);
+    mix.notes = 0;
+    std::function<void(int, int)> search = [&](int index, int remaining) {
+        if (remaining == 0) {
+            int mixScore = score(mix);
+            if (!best.isValid() || mix.notes < best.notes || (mix.notes == best.notes && mixScore > bestScore)) {
+                best = mix;
+                bestScore = mixScore;
+            }
+            return;
+        }
+        if (index == denoms.size()) {
+            return;
+        }
+        int most = qMin(counts[index] - reserved[index], remaining / denoms[index]);
+        for (int n = most; n >= 0; --n) {
+            if (mix.notes + n > MaxNotes || (best.isValid() && mix.notes + n > best.notes)) {
+                continue;
+            }
+            mix.counts[index] = n;
+            mix.notes += n;
+            search(index + 1, remaining - n * denoms[index]);
+            mix.notes -= n;
+        }
+        mix.counts[index] = 0;
+    };
+    search(0, amount);
+    return best;
+}
+
+CashDispenser::NoteMix CashDispenser::reserve(int amount)
+{
+    NoteMix mix = plan(amount);
+    if (mix.isValid()) {
+        for (int i = 0; i < denoms.size(); ++i) {
+            reserved[i] += mix.counts[i];
+        }
+    }
+    return mix;
+}
+
+void CashDispenser::release(const NoteMix &mix)
+{
+    for (int i = 0; i < denoms.size(); ++i) {
+        reserved[i] = qMax(0, reserved[i] - mix.counts[i]);
+    }
+}
+
+bool CashDispenser::dispense(const NoteMix &mix)
+{
+    if (!mix.isValid()) {
+        return false;
+    }
+    for (int i = 0; i < denoms.size(); ++i) {
+        if (reserved[i] < mix.counts[i] || counts[i] < mix.counts[i]) {
+            return false;
+        }
+    }
+    for (int i = 0; i < denoms.size(); ++i) {
+        counts[i] -= mix.counts[i];
+        reserved[i] -= mix.counts[i];
+    }
+    return true;
+}
+
+QString CashDispenser::describe(const NoteMix &mix) const
+{
+    QStringList parts;
+    for (int i = 0; i < denoms.size(); ++i) {
+        if (mix.counts[i] > 0) {
+            parts << QString("%1 x %2 €").arg(mix.counts[i]).arg(denoms[i]);
+        }
+    }
+    return parts.join(", ");
+}
@@ -0,0 +1,67 @@
+#ifndef CASHDISPENSER_H
+#define CASHDISPENSER_H
+
+#include <QString>
+#include <QVector>
+#include <array>
+
+// Setelikasettien varasto ja seteliyhdistelmän valinta nostolle.
+// Kaikki mahdolliset yhdistelmät lasketaan etukäteen summaa kohden, joten
+// nosto vain käy läpi muutaman valmiin ehdokkaan.
+class CashDispenser
+{
+public:
+    static const int MaxDenominations = 4;
+    static const int MaxAmount = 1000;      // Yhden noston yläraja euroina
+    static const int MaxNotes = 40;         // Setelimäärä, jonka luukku mahtuu antamaan
+    static const int MaxCandidates = 8;     // Ehdokasyhdistelmiä summaa kohden
+
+    struct NoteMix
+    {
+        NoteMix() : notes(0) { counts.fill(0); }
+
+        std::array<quint16, MaxDenominations> counts;
+        int notes;
+
+        bool isValid() const { return notes > 0; }
+    };
+
+    // Nimellisarvot suurimmasta pienimpään, esim. {50, 20}
+    explicit CashDispenser(const QVector<int> &denominations);
+
+    // Päätteen kasetit; alkutilanne luetaan ATM_CASSETTES_<lukija>-muuttujasta tai
+    // yhteisestä ATM_CASSETTES-muuttujasta, esim. "50:200,20:300"
+    static CashDispenser configured(const QString &readerId);
+
+    const QVector<int> &denominations() const { return denoms; }
+    int count(int denomination) const;
+    void setCount(int denomination, int count);
+
+    // Paras yhdistelmä varaamattomilla seteleillä: vähiten seteleitä, tasapuolisin kasettien kulutus
+    NoteMix plan(int amount) const;
+    bool canDispense(int amount) const { return plan(amount).isValid(); }
+
+    // Varaa setelit ennen kuin nosto veloitetaan, jotta samoja seteleitä ei luvata kahdesti;
+    // palauttaa virheellisen yhdistelmän, jos summaa ei voi antaa
+    NoteMix reserve(int amount);
+
+    // Palauttaa varauksen käytettäväksi (nosto hylättiin tai keskeytyi)
+    void release(const NoteMix &mix);
+
+    // Antaa varatut setelit kaseteista; false, jos niitä ei enää ole (varaus säilyy)
+    bool dispense(const NoteMix &mix);
+
+    QString describe(const NoteMix &mix) const;
+
+private:
+    void buildTable();
+    void addCandidate(int amount, const NoteMix &mix);
+    int score(const NoteMix &mix) const;
+
+    QVector<int> denoms;
+    QVector<int> counts;
+    QVector<int> reserved;
+    QVector<QVector<NoteMix>> table; // indeksi = summa
+};
+
+#endif // CASHDISPENSER_H
@@ -0,0 +1,39 @@
+#include "clientmetrics.h"
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+
+namespace {
+
+QMutex metricsMutex;
+QHash<QString, qint64> counters;
+
+} // namespace
+
+void ClientMetrics::increment(const QString &name, qint64 by)
+{
+    QMutexLocker locker(&metricsMutex);
+    counters[name] += by;
+}
+
+void ClientMetrics::set(const QString &name, qint64 value)
+{
+    QMutexLocker locker(&metricsMutex);
+    counters[name] = value;
+}
+
+qint64 ClientMetrics::value(const QString &name)
+{
+    QMutexLocker locker(&metricsMutex);
+    return counters.value(name);
+}
+
+QJsonObject ClientMetrics::snapshot()
+{
+    QMutexLocker locker(&metricsMutex);
+    QJsonObject json;
+    for (auto it = counters.constBegin(); it != counters.constEnd(); ++it) {
+        json[it.key()] = it.value();
+    }
+    return json;
+}
@@ -0,0 +1,17 @@
+#ifndef CLIENTMETRICS_H
+#define CLIENTMETRICS_H
+
+#include <QJsonObject>
+#include <QString>
+
+// Prosessin yhteiset laskurit (voidaan päivittää mistä tahansa säikeestä)
+class ClientMetrics
+{
+public:
+    static void increment(const QString &name, qint64 by = 1);
+    static void set(const QString &name, qint64 value);
+    static qint64 value(const QString &name);
+    static QJsonObject snapshot();
+};
+
+#endif // CLIENTMETRICS_H
@@ -1,11 +1,40 @@
 #include "mainwindow.h"
+#include "asynclogger.h"
+#include "startuptimeline.h"
+#include "stallwatchdog.h"
+#include "telemetryreporter.h"
+#include "terminalregistry.h"
 
 #include <QApplication>
+#include <QList>
 
 int main(int argc, char *argv[])
 {
+    StartupTimeline::start();
+
+    // Lokitus asennetaan ensimmäisenä, jotta käynnistyksen viestit eivät kirjoita GUI-säikeessä
+    AsyncLogger logger;
+    logger.start();
+
     QApplication a(argc, argv);
-    MainWindow w;
-    w.show();
-    return a.exec();
+
+    // Valvo GUI-tapahtumasilmukan jumeja koko ajon ajan
+    StallWatchdog watchdog;
+    watchdog.start();
+
+    // Kuntotiedot keskitetylle koostajalle, jos ATM_TELEMETRY_ADDR on asetettu
+    TelemetryReporter telemetry;
+    telemetry.start();
+
+    // Yksi pääte lukijaa kohden (ATM_READERS); kaikki jakavat verkkoyhteydet ja mittarit
+    QList<MainWindow*> terminals;
+    for (const QString &reader : TerminalRegistry::configuredReaders()) {
+        MainWindow *terminal = new MainWindow(reader);
+        terminal->show();
+        terminals.append(terminal);
+    }
+
+    int result = a.exec();
+    qDeleteAll(terminals);
+    return result;
 }
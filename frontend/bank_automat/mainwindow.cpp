@@ -1,25 +1,141 @@
 #include "mainwindow.h"
+#include "replyformatter.h"
+#include "sessiontrace.h"
+#include "startuptimeline.h"
+#include "stallwatchdog.h"
+#include "clientmetrics.h"
+#include "asynclogger.h"
+#include "cashdispenser.h"
+#include "terminalregistry.h"
 #include <QJsonObject>
 #include <QApplication>
 #include <QJsonDocument>
 #include <QMessageBox>
 #include <QVBoxLayout>
 #include <QDebug>
+#include <QNetworkCookie>
 #include <QNetworkCookieJar>
 #include <QJsonArray>
 #include <QDateTime>
 #include <QPushButton>
 #include <QHBoxLayout>
+#include <QHostInfo>
+#include <QThread>
+#include <QEvent>
+#include <QCloseEvent>
+#include <QStringList>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRandomGenerator>
+
+// Lukijakirjasto on prosessin yhteinen ja sen sarjaporttikäsittely voi tarvita
+// tapahtumasilmukan, joten kaikki sen kutsut ajetaan yhdessä pysyvässä lukijasäikeessä.
+// Säikeen jono myös vuorottaa päätteiden alustukset.
+static QThread *readerThread = nullptr;
+static QObject *readerContext = nullptr;
+
+static QObject *startReaderThread()
+{
+    if (!readerThread) {
+        readerThread = new QThread(QCoreApplication::instance());
+        readerThread->setObjectName("rfid-reader");
+        readerContext = new QObject;
+        readerContext->moveToThread(readerThread);
+    }
+    if (!readerThread->isRunning()) {
+        readerThread->start();
+    }
+    return readerContext;
+}
+
+// Toimintopyyntöjen aikaraja, kun istunnossa ei ole näkyvää ajastinta
+static const int ActionRequestBudgetMs = 10000;
+
+// Nostossa asiakas odottaa palvelimen vastausta aikarajaa pidempään: palvelin vastaa
+// aikarajaan mennessä joko kirjauksella tai 504:llä, ja vasta tämän jälkeen tulos on tuntematon
+static const int WithdrawalReplyGraceMs = 5000;
+
+// Lisää pyyntöön ehdoton aikaraja, jonka jälkeen palvelin ja asiakas luopuvat pyynnöstä
+static void setRequestDeadline(QNetworkRequest &request, int budgetMs)
+{
+    qint64 deadline = QDateTime::currentMSecsSinceEpoch() + budgetMs;
+    request.setRawHeader("X-Request-Deadline", QByteArray::number(deadline));
+    request.setTransferTimeout(budgetMs);
+}
+
+// Pyynnön tai vastauksen sisältö lokiin. PIN-koodin sisältäviä runkoja ei kirjata lainkaan,
+// ja muut peitetään jo ennen QDebugia, jonka escapointi muuttaisi kenttien muodon.
+static QString loggableBody(const QByteArray &body)
+{
+    if (body.contains("pin_code")) {
+        return "<sisältää PIN-koodin, ei kirjata>";
+    }
+    return AsyncLogger::redact(QString::fromUtf8(body));
+}
+
+// Ikkunan päätteen jäljitysistunto (nullptr, jos ikkuna ei kuulu päätteeseen)
+static SessionTrace *traceOf(QObject *window)
+{
+    MainWindow *terminal = MainWindow::terminalOf(window);
+    return terminal ? &terminal->sessionTrace() : nullptr;
+}
+
+// Kirjaa ikkunan päätteen istuntoon spanin, joka alkoi startUs-hetkellä ja päättyy nyt
+static void recordSpan(QObject *window, const char *name, qint64 startUs)
+{
+    if (SessionTrace *trace = traceOf(window)) {
+        trace->record(name, startUs, SessionTrace::nowUs());
+    }
+}
+
+// Liitä pyyntö ikkunan päätteen istunnon jäljitykseen
+static void setTraceHeader(QNetworkRequest &request, QObject *window)
+{
+    SessionTrace *trace = traceOf(window);
+    QByteArray traceId = trace ? trace->traceId() : QByteArray();
+    if (!traceId.isEmpty()) {
+        request.setRawHeader("X-Trace-Id", traceId);
+    }
+}
 
-// Määritä staattinen instanssi
-MainWindow* MainWindow::instance = nullptr;
+// Ikkunan päätteen kasetit. Päätteettömälle ikkunalle (ei esiinny sovelluksessa)
+// annetaan kasetiton automaatti, jolloin nostoja ei voi tehdä.
+static CashDispenser &dispenserOf(QObject *window)
+{
+    MainWindow *terminal = MainWindow::terminalOf(window);
+    if (terminal) {
+        return terminal->cashDispenser();
+    }
+    static CashDispenser noCassettes{ QVector<int>() };
+    return noCassettes;
+}
+
+// Verkkomanageri on päätteiden yhteinen, joten istunnon evästeet (token) kulkevat
+// päätteen omasta varastosta eivätkä managerin yhteisestä
+static void setTerminalCookies(QNetworkRequest &request, QObject *window)
+{
+    MainWindow *terminal = MainWindow::terminalOf(window);
+    if (!terminal) {
+        return;
+    }
+    QNetworkCookieJar *jar = terminal->cookieJar();
+    request.setAttribute(QNetworkRequest::CookieLoadControlAttribute, QNetworkRequest::Manual);
+    request.setAttribute(QNetworkRequest::CookieSaveControlAttribute, QNetworkRequest::Manual);
+    request.setAttribute(QNetworkRequest::User, QVariant::fromValue<QObject*>(jar));
+    QList<QNetworkCookie> cookies = jar->cookiesForUrl(request.url());
+    if (!cookies.isEmpty()) {
+        request.setHeader(QNetworkRequest::CookieHeader, QVariant::fromValue(cookies));
+    }
+}
 
 // MainWindow toteutus (Odottaa kortin skannausta)
-MainWindow::MainWindow(QWidget *parent)
-    : QMainWindow(parent), lastCardNumber("")
+MainWindow::MainWindow(const QString &readerId, QWidget *parent)
+    : QMainWindow(parent), reader(readerId), dispenser(CashDispenser::configured(readerId)), lastCardNumber(""), rfidLibrary(nullptr),
+      idleScreenPainted(false), readerInitQueued(false),
+      PrintDebugMessage(nullptr), SetCardReadCallback(nullptr), InitReader(nullptr), StartCardReading(nullptr), StopCardReading(nullptr)
 {
-    // Aseta tämä instanssi staattiseksi osoittimeksi
-    instance = this;
+    // Rekisteröi pääte, jotta lukijan korttitapahtumat ohjautuvat sille
+    TerminalRegistry::add(reader, this);
 
     // Luo keskuswidget ja asettelu
     QWidget *centralWidget = new QWidget(this);
@@ -30,16 +146,83 @@ MainWindow::MainWindow(QWidget *parent)
     statusLabel = new QLabel("Kortin skannausta odotetaan", this);
     layout->addWidget(statusLabel);
 
-    // Alusta verkkomanageri evästevarastolla
-    networkManager = new QNetworkAccessManager(this);
-    QNetworkCookieJar *cookieJar = new QNetworkCookieJar(networkManager);
-    networkManager->setCookieJar(cookieJar);
+    // Verkkomanageri jaetaan päätteiden kesken; evästevarasto on päätekohtainen
+    networkManager = TerminalRegistry::networkManager();
+    cookies = new QNetworkCookieJar(this);
 
-    // Lataa rfidlib DLL (QLibrary odottaa "rfidlib", joka vastaa librfidlib.dll-tiedostoa)
+    // Aseta ikkunan ominaisuudet
+    setWindowTitle("RFID-kortinlukija " + reader);
+    resize(300, 150);
+
+    // Odotusnäyttö näytetään ensin; lukija ja yhteydet alustetaan vasta sen ensimmäisen
+    // piirron jälkeen (event)
+    StartupTimeline::mark("window_constructed");
+}
+
+MainWindow::~MainWindow()
+{
+    // Päätteen ikkunat käyttävät sen kasetteja ja jäljitystä, joten ne poistetaan ennen jäseniä
+    qDeleteAll(findChildren<QMainWindow*>(QString(), Qt::FindDirectChildrenOnly));
+
+    TerminalRegistry::remove(this);
+    bool lastTerminal = TerminalRegistry::count() == 0;
+
+    // Lukijasäikeen jono on järjestyksessä, joten tämä odottaa myös kesken olevan alustuksen.
+    // Lukija pysäytetään vasta viimeisen päätteen poistuessa, koska kirjasto on yhteinen.
+    if (readerInitQueued) {
+        QMetaObject::invokeMethod(readerContext, [this, lastTerminal]() {
+            if (StopCardReading && lastTerminal) {
+                StopCardReading();
+            }
+        }, Qt::BlockingQueuedConnection);
+    }
+    if (lastTerminal && readerThread && readerThread->isRunning()) {
+        readerThread->quit();
+        readerThread->wait();
+    }
+    if (rfidLibrary && rfidLibrary->isLoaded()) {
+        rfidLibrary->unload();
+    }
+}
+
+bool MainWindow::event(QEvent *event)
+{
+    bool handled = QMainWindow::event(event);
+
+    // Odotusnäyttö on näkyvissä vasta, kun se on piirretty ensimmäisen kerran
+    if (event->type() == QEvent::Paint && !idleScreenPainted) {
+        idleScreenPainted = true;
+        StartupTimeline::mark("idle_screen");
+        QTimer::singleShot(0, this, &MainWindow::initializeDeferred);
+    }
+    return handled;
+}
+
+void MainWindow::initializeDeferred()
+{
+    // Ratkaise palvelimen nimi ja avaa yhteys valmiiksi ensimmäistä korttia varten
+    QHostInfo::lookupHost("localhost", this, [](const QHostInfo &) {
+        StartupTimeline::mark("dns_resolved");
+    });
+    networkManager->connectToHost("localhost", 3000);
+
+    // DLL:n lataus ja InitReader voivat kestää (sarjaportti), joten ne ajetaan lukijasäikeessä
     rfidLibrary = new QLibrary("librfidlib", this);
+    readerInitQueued = true;
+    QMetaObject::invokeMethod(startReaderThread(), [this]() {
+        QString error = loadReader();
+        QMetaObject::invokeMethod(this, [this, error]() {
+            readerError = error;
+            onReaderInitialized();
+        });
+    });
+}
+
+QString MainWindow::loadReader()
+{
+    // Lataa rfidlib DLL (QLibrary odottaa "rfidlib", joka vastaa librfidlib.dll-tiedostoa)
     if (!rfidLibrary->load()) {
-        statusLabel->setText("librfidlib.dll lataaminen epäonnistui: " + rfidLibrary->errorString());
-        return;
+        return "librfidlib.dll lataaminen epäonnistui: " + rfidLibrary->errorString();
     }
 
     // Ratkaise DLL:n funktiot
@@ -50,43 +233,50 @@ MainWindow::MainWindow(QWidget *parent)
     StopCardReading = (StopCardReadingFunc)rfidLibrary->resolve("StopCardReading");
 
     if (!PrintDebugMessage || !SetCardReadCallback || !InitReader || !StartCardReading || !StopCardReading) {
-        statusLabel->setText("DLL-funktioiden ratkaiseminen epäonnistui: " + rfidLibrary->errorString());
-        return;
+        StopCardReading = nullptr;
+        return "DLL-funktioiden ratkaiseminen epäonnistui: " + rfidLibrary->errorString();
     }
 
     // Kutsu PrintDebugMessage-funktiota
     PrintDebugMessage();
-    qDebug() << "DLL-funktio PrintDebugMessage kutsuttu onnistuneesti EXE:stä";
-
-    // Aseta takaisinkutsufunktio kortin lukemiselle
-    SetCardReadCallback(cardReadCallback);
+    qCDebug(lcCard) << "DLL-funktio PrintDebugMessage kutsuttu onnistuneesti EXE:stä";
+
+    // Aseta takaisinkutsufunktio kortin lukemiselle. Yhteinen kirjasto ilman lukijan tunnistetta
+    // ei kerro, mistä lukijasta kortti tuli, joten useaa päätettä ei silloin käynnistetä.
+    SetReaderCardReadCallbackFunc SetReaderCardReadCallback =
+        (SetReaderCardReadCallbackFunc)rfidLibrary->resolve("SetReaderCardReadCallback");
+    if (SetReaderCardReadCallback) {
+        SetReaderCardReadCallback(readerCardReadCallback);
+    } else if (TerminalRegistry::count() > 1) {
+        StopCardReading = nullptr;
+        return "Lukijakirjasto ei kerro lukijan tunnistetta (SetReaderCardReadCallback puuttuu), joten vain yksi pääte voi olla käytössä";
+    } else {
+        SetCardReadCallback(cardReadCallback);
+    }
 
-    // Alusta RFID-lukija
-    if (!InitReader("COM3")) {
-        statusLabel->setText("RFID-lukijan alustaminen epäonnistui");
-        return;
+    // Alusta tämän päätteen RFID-lukija
+    if (!InitReader(reader.toLocal8Bit().constData())) {
+        StopCardReading = nullptr;
+        return "RFID-lukijan alustaminen epäonnistui";
     }
 
     // Aloita kortin lukeminen
     StartCardReading();
-
-    // Aseta ikkunan ominaisuudet
-    setWindowTitle("RFID-kortinlukija");
-    resize(300, 150);
+    return QString();
 }
 
-MainWindow::~MainWindow()
+void MainWindow::onReaderInitialized()
 {
-    // Pysäytä kortin lukeminen ja vapauta resurssit
-    if (StopCardReading) {
-        StopCardReading();
+    if (!readerError.isEmpty()) {
+        statusLabel->setText(readerError);
     }
-    if (rfidLibrary && rfidLibrary->isLoaded()) {
-        rfidLibrary->unload();
+    // Telemetrian lukijatila: 1 = kaikki lukijat valmiina, 2 = jokin lukija virheessä
+    if (!readerError.isEmpty()) {
+        ClientMetrics::increment("readers_failed");
     }
-
-    // Tyhjennä staattinen instanssi
-    instance = nullptr;
+    ClientMetrics::set("reader_state", ClientMetrics::value("readers_failed") > 0 ? 2 : 1);
+    StartupTimeline::mark("reader_ready");
+    qCDebug(lcUi) << "Käynnistyksen aikajana:" << StartupTimeline::summary();
 }
 
 // Implementation of the show slot
@@ -95,44 +285,68 @@ void MainWindow::show()
     QMainWindow::show();
 }
 
-// Getter for the instance
-MainWindow* MainWindow::getInstance()
+// Istunto päättyy vasta, kun asiakas lopettaa (tervetuloikkuna suljetaan, tunnistautuminen
+// epäonnistuu tai seuraava kortti luetaan), ei jokaisen toiminnon jälkeen
+void MainWindow::endCustomerSession()
 {
-    return instance;
+    trace.endSession();
+    qCDebug(lcUi) << "Mittarit:" << QJsonDocument(ClientMetrics::snapshot()).toJson(QJsonDocument::Compact);
 }
 
-void MainWindow::cardReadCallback(const char* cardNumber)
+MainWindow* MainWindow::terminalOf(QObject *object)
 {
-    if (!MainWindow::getInstance()) {
-        qDebug() << "Virhe: MainWindow-instanssia ei ole asetettu!";
-        return;
+    // Päätteen ikkunat ovat sen MainWindow'n jälkeläisiä
+    for (QObject *current = object; current; current = current->parent()) {
+        if (MainWindow *terminal = qobject_cast<MainWindow*>(current)) {
+            return terminal;
+        }
     }
+    return nullptr;
+}
 
-    // Käsittele korttinumero DLL:stä
-    QString cardNum = QString(cardNumber).trimmed();
-    qDebug() << "Kortti luettu DLL:stä (takaisinkutsu):" << cardNum;
+void MainWindow::cardReadCallback(const char* cardNumber)
+{
+    // Yhden lukijan rajapinta: lukija ei ole tiedossa, joten rekisteri hyväksyy vain yhden päätteen
+    TerminalRegistry::dispatchCardRead(QString(), QString(cardNumber).trimmed());
+}
+
+void MainWindow::readerCardReadCallback(const char *readerId, const char *cardNumber)
+{
+    // Lukijakirjaston takaisinkutsu on prosessin yhteinen; rekisteri valitsee päätteen lukijan mukaan
+    TerminalRegistry::dispatchCardRead(QString(readerId).trimmed(), QString(cardNumber).trimmed());
+}
+
+void MainWindow::handleCardRead(const QString &cardNum)
+{
+    qCDebug(lcCard) << "Kortti luettu lukijasta" << reader << ":" << cardNum;
 
     // Tarkista, onko kyseessä uusi korttinumero duplikaattien välttämiseksi
-    if (cardNum != MainWindow::getInstance()->lastCardNumber) {
-        MainWindow::getInstance()->lastCardNumber = cardNum;
-        MainWindow::getInstance()->statusLabel->setText("Kortti skannattu: " + cardNum);
+    if (cardNum != lastCardNumber) {
+        // Edellinen istunto kirjoitetaan talteen, jos sitä ei ole vielä päätetty
+        trace.endSession();
+        trace.beginSession();
+        TraceSpan span(&trace, "card_read");
+        lastCardNumber = cardNum;
+        statusLabel->setText("Kortti skannattu: " + cardNum);
 
         // Avaa PIN-syöttöikkuna ja välitä jaettu verkkomanageri
-        PinInputWindow *pinWindow = new PinInputWindow(cardNum, MainWindow::getInstance()->networkManager, MainWindow::getInstance());
-        QObject::connect(pinWindow, &PinInputWindow::authenticationCompleted, MainWindow::getInstance(),
+        PinInputWindow *pinWindow = new PinInputWindow(cardNum, networkManager, this);
+        QObject::connect(pinWindow, &PinInputWindow::authenticationCompleted, this,
                          &MainWindow::onAuthenticationCompleted);
         pinWindow->show();
-        MainWindow::getInstance()->hide();
+        hide();
     }
 }
 
 void MainWindow::onAuthenticationCompleted(const QString &firstName, const QString &lastName, int accountId, const QString &cardNumber, const QString &pinCode, const QString &token, const QString &cardType)
 {
+    StallScope stallScope("MainWindow::onAuthenticationCompleted");
     // Only proceed if authentication was successful (firstName is not empty and accountId is not -1)
     if (firstName.isEmpty() || accountId == -1) {
-        qDebug() << "Authentication failed, returning to MainWindow";
+        qCDebug(lcUi) << "Authentication failed, returning to MainWindow";
         lastCardNumber = "";
         statusLabel->setText("Kortin skannausta odotetaan");
+        endCustomerSession();
         show();
         return;
     }
@@ -144,13 +358,29 @@ void MainWindow::onAuthenticationCompleted(const QString &firstName, const QStri
     // Open WelcomeWindow
     WelcomeWindow *welcomeWindow = new WelcomeWindow(firstName, lastName, accountId, cardNumber, pinCode, token, cardType, networkManager, this);
     QObject::connect(welcomeWindow, &WelcomeWindow::actionCompleted, this, &MainWindow::show);
+    QObject::connect(welcomeWindow, &WelcomeWindow::sessionEnded, this, &MainWindow::endCustomerSession);
     welcomeWindow->show();
     hide();
 }
 
+// Estetty kortti: sulje päätteen muut ikkunat ja palaa odotusnäyttöön (muut päätteet jatkavat)
+static void closeTerminalWindows(QWidget *current)
+{
+    MainWindow *terminal = MainWindow::terminalOf(current);
+    for (QWidget *widget : QApplication::topLevelWidgets()) {
+        if (widget != terminal && widget != current && MainWindow::terminalOf(widget) == terminal) {
+            qCDebug(lcUi) << "Closing window:" << widget->windowTitle();
+            widget->close();
+        }
+    }
+    if (terminal) {
+        terminal->show();
+    }
+}
+
 // PinInputWindow toteutus (PIN-koodin syöttö painikkeilla)
 PinInputWindow::PinInputWindow(const QString &cardNumber, QNetworkAccessManager *sharedNetworkManager, QWidget *parent)
-    : QMainWindow(parent), cardNumber(cardNumber), pinCode(""), networkManager(sharedNetworkManager), failedAttempts(0), timeRemaining(10)
+    : QMainWindow(parent), cardNumber(cardNumber), pinCode(""), networkManager(sharedNetworkManager), failedAttempts(0), timeRemaining(10), shownAtUs(SessionTrace::nowUs())
 {
     // Luo keskuswidget ja asettelu
     QWidget *centralWidget = new QWidget(this);
@@ -242,6 +472,7 @@ void PinInputWindow::onClearButtonClicked()
 
 void PinInputWindow::onSubmitButtonClicked()
 {
+    StallScope stallScope("PinInputWindow::onSubmitButtonClicked");
     if (pinCode.length() != 4) {
         QMessageBox::warning(this, "Virhe", "PIN-koodin on oltava 4 numeroa!");
         return;
@@ -249,6 +480,7 @@ void PinInputWindow::onSubmitButtonClicked()
 
     // Pysäytä ajastin, koska käyttäjä lähetti PIN-koodin
     timer->stop();
+    recordSpan(this, "pin_entry", shownAtUs);
 
     // Luo JSON-objekti korttinumerolla ja PIN-koodilla
     QJsonObject json;
@@ -262,16 +494,18 @@ void PinInputWindow::onSubmitButtonClicked()
     // Luo pyyntö
     QNetworkRequest request(QUrl("http://localhost:3000/cards/auth"));
     request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+    setRequestDeadline(request, timeRemaining * 1000);
+    setTraceHeader(request, this);
+    setTerminalCookies(request, this);
 
     // Debuggaa pyyntö
-    qDebug() << "Lähetetään pyyntö osoitteeseen:" << request.url().toString();
-    qDebug() << "Pyynnön sisältö:" << data;
-
-    // Lähetä POST-pyyntö
-    QNetworkReply *reply = networkManager->post(request, data);
+    qCDebug(lcNetwork) << "Lähetetään pyyntö osoitteeseen:" << request.url().toString();
+    qCDebug(lcNetwork).noquote() << "Pyynnön sisältö:" << loggableBody(data);
 
-    // Yhdistä vastaussignaali
-    connect(reply, &QNetworkReply::finished, this, [this, reply]() {
+    // Lähetä POST-pyyntö (kirjoittava pyyntö, ei jaeta muiden kanssa)
+    qint64 requestStartUs = SessionTrace::nowUs();
+    RequestCoalescer::of(networkManager)->post(request, data, this, [this, requestStartUs](const CoalescedReply &reply) {
+        recordSpan(this, "auth_request", requestStartUs);
         onNetworkReply(reply);
     });
 }
@@ -282,128 +516,73 @@ void PinInputWindow::resetPinInput()
     pinDisplayLabel->setText("****");
 }
 
-void PinInputWindow::onNetworkReply(QNetworkReply *reply)
+void PinInputWindow::onNetworkReply(const CoalescedReply &reply)
 {
-    QByteArray response = reply->readAll();
-    qDebug() << "Raaka vastaus /cards/auth-osoitteesta:" << response;
+    StallScope stallScope("PinInputWindow::onNetworkReply");
+    TraceSpan span(traceOf(this), "auth_reply_handler");
+    qCDebug(lcNetwork).noquote() << "Raaka vastaus /cards/auth-osoitteesta:" << loggableBody(reply.body);
 
-    QJsonDocument doc = QJsonDocument::fromJson(response);
+    const QJsonDocument &doc = reply.doc;
     QJsonObject json = doc.object();
 
-    if (reply->error() != QNetworkReply::NoError) {
+    if (reply.error != QNetworkReply::NoError) {
         QString errorMsg;
         if (!doc.isNull() && json.contains("error")) {
             errorMsg = json["error"].toString();
             if (errorMsg.contains("Kortti on estetty")) {
-                for (QWidget *widget : QApplication::topLevelWidgets()) {
-                    if (widget != MainWindow::getInstance() && widget != this) {
-                        qDebug() << "Closing window:" << widget->windowTitle();
-                        widget->close();
-                    }
-                }
-                if (MainWindow::getInstance()) {
-                    MainWindow::getInstance()->show();
-                }
+                closeTerminalWindows(this);
                 QMessageBox::warning(this, "Virhe", errorMsg);
                 close();
-                reply->deleteLater();
                 return;
             }
         } else {
-            errorMsg = "Tunnistautuminen epäonnistui: " + reply->errorString();
+            errorMsg = "Tunnistautuminen epäonnistui: " + reply.errorString;
         }
-        qDebug() << "Verkkovirhe:" << errorMsg;
+        qCDebug(lcNetwork) << "Verkkovirhe:" << errorMsg;
         QMessageBox::warning(this, "Virhe", errorMsg);
         resetPinInput();
-        reply->deleteLater();
         return;
     }
 
     if (doc.isNull()) {
         QString errorMsg = "Vastauksen jäsentäminen JSON-muotoon epäonnistui";
-        qDebug() << errorMsg;
+        qCDebug(lcNetwork) << errorMsg;
         QMessageBox::warning(this, "Virhe", errorMsg);
         resetPinInput();
-        reply->deleteLater();
         return;
     }
 
     if (!json.contains("success") || !json["success"].toBool()) {
         QString errorMsg = json.contains("error") ? json["error"].toString() : "Tuntematon virhe";
-        qDebug() << "Tunnistautuminen epäonnistui virheellä:" << errorMsg;
+        qCDebug(lcNetwork) << "Tunnistautuminen epäonnistui virheellä:" << errorMsg;
         if (errorMsg.contains("Kortti on estetty")) {
-            for (QWidget *widget : QApplication::topLevelWidgets()) {
-                if (widget != MainWindow::getInstance() && widget != this) {
-                    qDebug() << "Closing window:" << widget->windowTitle();
-                    widget->close();
-                }
-            }
-            if (MainWindow::getInstance()) {
-                MainWindow::getInstance()->show();
-            }
+            closeTerminalWindows(this);
             QMessageBox::warning(this, "Virhe", errorMsg);
             close();
-            reply->deleteLater();
             return;
         }
         QMessageBox::warning(this, "Virhe", "Virhe: Väärä PIN-koodi");
         resetPinInput();
-        reply->deleteLater();
-        return;
-    }
-
-    if (!json.contains("customer") || !json["customer"].isObject()) {
-        QString errorMsg = "Vastauksesta puuttuu 'customer'-objekti";
-        qDebug() << errorMsg;
-        QMessageBox::warning(this, "Virhe", errorMsg);
-        resetPinInput();
-        reply->deleteLater();
-        return;
-    }
-
-    QJsonObject customer = json["customer"].toObject();
-    if (!customer.contains("first_name") || !customer.contains("last_name")) {
-        QString errorMsg = "Vastauksesta puuttuu 'first_name' tai 'last_name' asiakasobjektissa";
-        qDebug() << errorMsg;
-        QMessageBox::warning(this, "Virhe", errorMsg);
-        resetPinInput();
-        reply->deleteLater();
-        return;
-    }
-
-    if (!json.contains("account_id")) {
-        QString errorMsg = "Vastauksesta puuttuu 'account_id'";
-        qDebug() << errorMsg;
-        QMessageBox::warning(this, "Virhe", errorMsg);
-        resetPinInput();
-        reply->deleteLater();
         return;
     }
 
-    if (!json.contains("card_type")) {
-        QString errorMsg = "Vastauksesta puuttuu 'card_type'";
-        qDebug() << errorMsg;
-        QMessageBox::warning(this, "Virhe", errorMsg);
+    AuthReply auth = parseAuthReply(json);
+    if (!auth.valid) {
+        qCDebug(lcNetwork) << auth.error;
+        QMessageBox::warning(this, "Virhe", auth.error);
         resetPinInput();
-        reply->deleteLater();
         return;
     }
 
-    QString firstName = customer["first_name"].toString();
-    QString lastName = customer["last_name"].toString();
-    int accountId = json["account_id"].toInt();
-    QString cardType = json["card_type"].toString();
-
-    qDebug() << "Tunnistautuminen onnistui. Etunimi:" << firstName << ", Sukunimi:" << lastName << ", Tilin ID:" << accountId << ", Korttityyppi:" << cardType;
-    emit authenticationCompleted(firstName, lastName, accountId, cardNumber, pinCode, "", cardType);
+    qCDebug(lcUi) << "Tunnistautuminen onnistui. Etunimi:" << auth.firstName << ", Sukunimi:" << auth.lastName << ", Tilin ID:" << auth.accountId << ", Korttityyppi:" << auth.cardType;
+    emit authenticationCompleted(auth.firstName, auth.lastName, auth.accountId, cardNumber, pinCode, "", auth.cardType);
 
     close();
-    reply->deleteLater();
 }
 
 // WelcomeWindow toteutus
 WelcomeWindow::WelcomeWindow(const QString &firstName, const QString &lastName, int accountId, const QString &cardNumber, const QString &pinCode, const QString &token, const QString &cardType, QNetworkAccessManager *sharedNetworkManager, QWidget *parent)
-    : QMainWindow(parent), firstName(firstName), lastName(lastName), accountId(accountId), cardNumber(cardNumber), pinCode(pinCode), token(token), cardType(cardType), networkManager(sharedNetworkManager)
+    : QMainWindow(parent), firstName(firstName), lastName(lastName), accountId(accountId), cardNumber(cardNumber), pinCode(pinCode), token(token), cardType(cardType), networkManager(sharedNetworkManager), withdrawalLimit(-1.0)
 {
     // Luo keskuswidget ja asettelu
     QWidget *centralWidget = new QWidget(this);
@@ -439,17 +618,51 @@ WelcomeWindow::WelcomeWindow(const QString &firstName, const QString &lastName,
     // Aseta ikkunan ominaisuudet
     setWindowTitle("Tervetuloa");
     resize(300, 200);
+
+    // Nostoraja haetaan valmiiksi, jotta nostonäkymä voi näyttää sen heti
+    fetchWithdrawalLimit();
 }
 
 WelcomeWindow::~WelcomeWindow()
 {
 }
 
+void WelcomeWindow::closeEvent(QCloseEvent *event)
+{
+    emit sessionEnded();
+    QMainWindow::closeEvent(event);
+}
+
+void WelcomeWindow::fetchWithdrawalLimit()
+{
+    QNetworkRequest request(QUrl("http://localhost:3000/transactions/limits"));
+    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+    setRequestDeadline(request, ActionRequestBudgetMs);
+    setTraceHeader(request, this);
+    setTerminalCookies(request, this);
+
+    QJsonObject json;
+    json["card_number"] = cardNumber;
+    QByteArray data = QJsonDocument(json).toJson(QJsonDocument::Compact);
+
+    RequestCoalescer::of(networkManager)->postShared(request, data, this, [this](const CoalescedReply &reply) {
+        QJsonObject limits = reply.doc.object();
+        if (reply.error == QNetworkReply::NoError && limits.contains("per_transaction")) {
+            // Päivän nostokerrat käytetty: raja on nolla summasta riippumatta
+            bool countExhausted = limits.contains("daily_count") && limits["daily_count"].toInt() <= 0;
+            withdrawalLimit = countExhausted ? 0.0 : jsonAmount(limits["per_transaction"]);
+        } else {
+            qCDebug(lcNetwork) << "Nostorajan haku epäonnistui:" << reply.errorString;
+        }
+    });
+}
+
 void WelcomeWindow::onWithdrawalClicked()
 {
-    qDebug() << "Nosto-painiketta klikattu";
+    qCDebug(lcUi) << "Nosto-painiketta klikattu";
     ActionWindow *actionWindow = new ActionWindow(ActionWindow::Withdrawal, accountId, cardNumber, pinCode, cardType, networkManager, this, this);
     connect(actionWindow, &ActionWindow::actionFinished, this, [this]() {
+        fetchWithdrawalLimit();
         show();
         emit actionCompleted();
     });
@@ -459,7 +672,7 @@ void WelcomeWindow::onWithdrawalClicked()
 
 void WelcomeWindow::onTopUpClicked()
 {
-    qDebug() << "Talletus-painiketta klikattu";
+    qCDebug(lcUi) << "Talletus-painiketta klikattu";
     ActionWindow *actionWindow = new ActionWindow(ActionWindow::TopUp, accountId, cardNumber, pinCode, cardType, networkManager, this, this);
     connect(actionWindow, &ActionWindow::actionFinished, this, [this]() {
         show();
@@ -471,7 +684,7 @@ void WelcomeWindow::onTopUpClicked()
 
 void WelcomeWindow::onBalanceClicked()
 {
-    qDebug() << "Saldo-painiketta klikattu";
+    qCDebug(lcUi) << "Saldo-painiketta klikattu";
     ActionWindow *actionWindow = new ActionWindow(ActionWindow::Balance, accountId, cardNumber, pinCode, cardType, networkManager, this, this);
     connect(actionWindow, &ActionWindow::actionFinished, this, [this]() {
         show();
@@ -483,7 +696,7 @@ void WelcomeWindow::onBalanceClicked()
 
 void WelcomeWindow::onHistoryClicked()
 {
-    qDebug() << "Historia-painiketta klikattu";
+    qCDebug(lcUi) << "Historia-painiketta klikattu";
     ActionWindow *actionWindow = new ActionWindow(ActionWindow::History, accountId, cardNumber, pinCode, cardType, networkManager, this, this);
     connect(actionWindow, &ActionWindow::actionFinished, this, [this]() {
         show();
@@ -493,9 +706,16 @@ void WelcomeWindow::onHistoryClicked()
     hide();
 }
 
+// Nostettavan summan on oltava kokonaisia euroja ja annettavissa kasettien seteleillä
+static bool isDispensable(const CashDispenser &dispenser, double amount)
+{
+    int whole = qRound(amount);
+    return qFuzzyCompare(amount, static_cast<double>(whole)) && dispenser.canDispense(whole);
+}
+
 // ActionWindow toteutus
 ActionWindow::ActionWindow(ActionType type, int accountId, const QString &cardNumber, const QString &pinCode, const QString &cardType, QNetworkAccessManager *sharedNetworkManager, WelcomeWindow *welcomeWindow, QWidget *parent)
-    : QMainWindow(parent), actionType(type), accountId(accountId), cardNumber(cardNumber), pinCode(pinCode), cardType(cardType), networkManager(sharedNetworkManager), amountInput(nullptr), resultLabel(nullptr), pendingAmount(0.0), welcomeWindow(welcomeWindow)
+    : QMainWindow(parent), actionType(type), accountId(accountId), cardNumber(cardNumber), pinCode(pinCode), cardType(cardType), networkManager(sharedNetworkManager), amountInput(nullptr), resultLabel(nullptr), pendingAmount(0.0), welcomeWindow(welcomeWindow), reAuthStartUs(0)
 {
     // Luo keskuswidget ja asettelu
     QWidget *centralWidget = new QWidget(this);
@@ -509,6 +729,14 @@ ActionWindow::ActionWindow(ActionType type, int accountId, const QString &cardNu
         instructionLabel->setAlignment(Qt::AlignCenter);
         layout->addWidget(instructionLabel);
 
+        // Istunnon alussa haettu nostoraja
+        double limit = welcomeWindow ? welcomeWindow->remainingWithdrawalLimit() : -1.0;
+        if (limit >= 0) {
+            QLabel *limitLabel = new QLabel(QString("Nostoraja jäljellä: %1 €").arg(limit, 0, 'f', 2), this);
+            limitLabel->setAlignment(Qt::AlignCenter);
+            layout->addWidget(limitLabel);
+        }
+
         // Painikkeet ennalta määritellyille summille
         QHBoxLayout *amountButtonsLayout1 = new QHBoxLayout();
         QHBoxLayout *amountButtonsLayout2 = new QHBoxLayout();
@@ -528,6 +756,16 @@ ActionWindow::ActionWindow(ActionType type, int accountId, const QString &cardNu
         layout->addLayout(amountButtonsLayout2);
         layout->addWidget(otherAmountButton);
 
+        // Piilota summat, joita kasettien seteleillä ei voi antaa tai jotka ylittävät nostorajan
+        const CashDispenser &dispenser = dispenserOf(this);
+        auto offered = [&dispenser, limit](int amount) {
+            return dispenser.canDispense(amount) && (limit < 0 || amount <= limit);
+        };
+        amount20Button->setVisible(offered(20));
+        amount40Button->setVisible(offered(40));
+        amount50Button->setVisible(offered(50));
+        amount100Button->setVisible(offered(100));
+
         // Syöte muulle summalle (piilotettu aluksi)
         amountInput = new QLineEdit(this);
         amountInput->setPlaceholderText("Syötä summa");
@@ -603,7 +841,7 @@ ActionWindow::ActionWindow(ActionType type, int accountId, const QString &cardNu
         setWindowTitle(actionType == Balance ? "Saldo" : "Tapahtumahistoria");
 
         // Aloita uudelleentunnistautumisprosessi
-        qDebug() << "Aloitetaan uudelleentunnistautuminen toiminnolle:" << (actionType == Balance ? "Saldo" : "Historia");
+        qCDebug(lcUi) << "Aloitetaan uudelleentunnistautuminen toiminnolle:" << (actionType == Balance ? "Saldo" : "Historia");
         reAuthenticateAndProceed();
     }
 
@@ -612,11 +850,77 @@ ActionWindow::ActionWindow(ActionType type, int accountId, const QString &cardNu
 
 ActionWindow::~ActionWindow()
 {
+    // Vastaamatta jääneen noston tulos on tuntematon: nosto perutaan palvelimella ja
+    // varatut setelit palautetaan käytettäviksi
+    reverseWithdrawal();
+    releaseReservedNotes();
+}
+
+void ActionWindow::releaseReservedNotes()
+{
+    if (reservedNotes.isValid()) {
+        dispenserOf(this).release(reservedNotes);
+        reservedNotes = CashDispenser::NoteMix();
+    }
+}
+
+// Peruutusta yritetään uudelleen, kunnes palvelin kuittaa sen; palvelin käsittelee viitteen
+// idempotentisti, joten toisto ei hyvitä tiliä kahdesti. Pysyvä hylkäys (esim. vanhentunut
+// token) jätetään lokiin ja mittariin käsin täsmäytettäväksi.
+static void sendWithdrawalReversal(QNetworkAccessManager *manager, QNetworkRequest request, const QByteArray &data, const QByteArray &reference, int attempt)
+{
+    setRequestDeadline(request, ActionRequestBudgetMs);
+    RequestCoalescer::of(manager)->post(request, data, manager, [manager, request, data, reference, attempt](const CoalescedReply &reply) {
+        if (reply.error == QNetworkReply::NoError) {
+            bool reversed = reply.doc.object()["reversed"].toBool();
+            ClientMetrics::increment(reversed ? "withdrawals_reversed" : "withdrawals_void");
+            qCWarning(lcUi) << "Noston peruutus kuitattu, viite" << reference << (reversed ? "hyvitetty" : "nostoa ei kirjattu");
+            return;
+        }
+
+        // Verkkovirhe, 409 (nosto tai peruutus kesken) ja 5xx ovat tilapäisiä
+        bool transient = reply.httpStatus == 0 || reply.httpStatus == 409 || reply.httpStatus >= 500;
+        if (!transient) {
+            ClientMetrics::increment("withdrawal_reversal_failed");
+            qCCritical(lcUi) << "Noston peruutus hylättiin, täsmäytettävä käsin: viite" << reference
+                             << "tila" << reply.httpStatus << reply.errorString;
+            return;
+        }
+        int delayMs = qMin(1000 << qMin(attempt, 5), 30000);
+        ClientMetrics::increment("withdrawal_reversal_retries");
+        qCWarning(lcUi) << "Noston peruutus epäonnistui, uusi yritys" << delayMs << "ms kuluttua: viite" << reference << reply.errorString;
+        QTimer::singleShot(delayMs, manager, [manager, request, data, reference, attempt]() {
+            sendWithdrawalReversal(manager, request, data, reference, attempt + 1);
+        });
+    });
+}
+
+// Nosto perutaan palvelimella viitteen mukaan: kirjattu nosto hyvitetään ja vapautetaan
+// nostorajoista, kirjaamaton mitätöidään, ettei se enää kirjaudu
+void ActionWindow::reverseWithdrawal()
+{
+    if (withdrawalReference.isEmpty()) {
+        return;
+    }
+    qCWarning(lcUi) << "Perutaan nosto" << pendingAmount << "€ tililtä" << accountId << "viite" << withdrawalReference;
+
+    QNetworkRequest request(QUrl("http://localhost:3000/transactions/reverse_withdrawal"));
+    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+    setTraceHeader(request, this);
+    setTerminalCookies(request, this);
+
+    QJsonObject json;
+    json["reference"] = QString::fromLatin1(withdrawalReference);
+
+    // Peruutus ei saa katketa, vaikka ikkuna suljetaan, joten kontekstina on verkkomanageri
+    sendWithdrawalReversal(networkManager, request, QJsonDocument(json).toJson(QJsonDocument::Compact), withdrawalReference, 0);
+    withdrawalReference.clear();
 }
 
 void ActionWindow::reAuthenticateAndProceed()
 {
-    qDebug() << "Avataan PinInputWindow uudelleentunnistautumista varten";
+    qCDebug(lcUi) << "Avataan PinInputWindow uudelleentunnistautumista varten";
+    reAuthStartUs = SessionTrace::nowUs();
     PinInputWindow *pinWindow = new PinInputWindow(cardNumber, networkManager, this);
     connect(pinWindow, &PinInputWindow::authenticationCompleted, this, &ActionWindow::onReAuthenticationCompleted);
     pinWindow->show();
@@ -624,7 +928,8 @@ void ActionWindow::reAuthenticateAndProceed()
 
 void ActionWindow::onReAuthenticationCompleted(const QString &firstName, const QString &lastName, int accountId, const QString &cardNumber, const QString &pinCode, const QString &newToken)
 {
-    qDebug() << "Uudelleentunnistautuminen valmis. Etunimi:" << firstName << ", Tilin ID:" << accountId;
+    recordSpan(this, "reauthenticate", reAuthStartUs);
+    qCDebug(lcUi) << "Uudelleentunnistautuminen valmis. Etunimi:" << firstName << ", Tilin ID:" << accountId;
     if (firstName.isEmpty() || accountId == -1) {
         // Tunnistautuminen epäonnistui, sulje ikkuna
         QMessageBox::warning(this, "Virhe", "Tunnistautuminen epäonnistui. Toimintoa ei voi jatkaa.");
@@ -642,7 +947,7 @@ void ActionWindow::onReAuthenticationCompleted(const QString &firstName, const Q
 
     // Talletukselle sulje ActionWindow onnistuneen tunnistautumisen jälkeen
     if (actionType == TopUp) {
-        qDebug() << "Suljetaan ActionWindow onnistuneen tunnistautumisen jälkeen talletukselle";
+        qCDebug(lcUi) << "Suljetaan ActionWindow onnistuneen tunnistautumisen jälkeen talletukselle";
         close();
     }
 
@@ -659,6 +964,19 @@ void ActionWindow::onSubmitButtonClicked()
             QMessageBox::warning(this, "Virhe", "Syötä kelvollinen summa.");
             return;
         }
+        if (actionType == Withdrawal && !isDispensable(dispenserOf(this), amount)) {
+            QStringList notes;
+            for (int denomination : dispenserOf(this).denominations()) {
+                notes << QString::number(denomination);
+            }
+            QMessageBox::warning(this, "Virhe", QString("Summaa ei voi antaa automaatin seteleillä (%1 €).").arg(notes.join(", ")));
+            return;
+        }
+        double limit = welcomeWindow ? welcomeWindow->remainingWithdrawalLimit() : -1.0;
+        if (actionType == Withdrawal && limit >= 0 && amount > limit) {
+            QMessageBox::warning(this, "Virhe", QString("Summa ylittää jäljellä olevan nostorajan (%1 €).").arg(limit, 0, 'f', 2));
+            return;
+        }
         pendingAmount = amount;
     } else if (pendingAmount == 0.0) {
         // Jos painiketta ei ole vielä valittu ja amountInput ei ole näkyvissä
@@ -670,23 +988,38 @@ void ActionWindow::onSubmitButtonClicked()
     if (amountInput) {
         amountInput->setEnabled(false);
     }
-    qDebug() << "Lähetä-painiketta klikattu toiminnolle:" << (actionType == Withdrawal ? "Nosto" : "Talletus") << ", Summa:" << pendingAmount;
+    qCDebug(lcUi) << "Lähetä-painiketta klikattu toiminnolle:" << (actionType == Withdrawal ? "Nosto" : "Talletus") << ", Summa:" << pendingAmount;
     reAuthenticateAndProceed();
 }
 
 void ActionWindow::performAction()
 {
-    qDebug() << "Suoritetaan toiminto:" << (actionType == Withdrawal ? "Nosto" : actionType == TopUp ? "Talletus" : actionType == Balance ? "Saldo" : "Historia");
+    StallScope stallScope("ActionWindow::performAction");
+    qCDebug(lcUi) << "Suoritetaan toiminto:" << (actionType == Withdrawal ? "Nosto" : actionType == TopUp ? "Talletus" : actionType == Balance ? "Saldo" : "Historia");
     QNetworkRequest request;
     QJsonObject json;
     QJsonDocument doc;
     QByteArray data;
 
     if (actionType == Withdrawal) {
+        // Setelit varataan ennen veloitusta, jotta veloitettu summa voidaan myös antaa
+        releaseReservedNotes();
+        reservedNotes = dispenserOf(this).reserve(qRound(pendingAmount));
+        if (!reservedNotes.isValid()) {
+            QMessageBox::warning(this, "Nosto", "Summaa ei voi juuri nyt antaa automaatin seteleillä.");
+            emit actionFinished();
+            close();
+            return;
+        }
+        // Nostokohtainen viite, jolla nosto voidaan perua palvelimella
+        SessionTrace *trace = traceOf(this);
+        withdrawalReference = (trace ? trace->traceId() : QByteArray("notrace")) + "-"
+                              + QByteArray::number(QRandomGenerator::global()->generate64(), 16);
         request.setUrl(QUrl("http://localhost:3000/transactions/withdraw"));
         json["card_number"] = cardNumber;
         json["pin_code"] = pinCode;
         json["amount"] = pendingAmount;
+        json["reference"] = QString::fromLatin1(withdrawalReference);
     } else if (actionType == TopUp) {
         request.setUrl(QUrl("http://localhost:3000/transactions/top_up"));
         json["account_id"] = accountId;  // Sisällytä account_id
@@ -701,46 +1034,70 @@ void ActionWindow::performAction()
     }
 
     request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+    setRequestDeadline(request, ActionRequestBudgetMs);
+    if (actionType == Withdrawal) {
+        // Nosto ei ole idempotentti, joten asiakas ei luovu siitä ennen palvelinta
+        request.setTransferTimeout(ActionRequestBudgetMs + WithdrawalReplyGraceMs);
+    }
+    setTraceHeader(request, this);
+    setTerminalCookies(request, this);
 
     // Debuggaa pyyntö
-    qDebug() << "Lähetetään toimintopyyntö osoitteeseen:" << request.url().toString();
+    qCDebug(lcNetwork) << "Lähetetään toimintopyyntö osoitteeseen:" << request.url().toString();
 
     doc.setObject(json);
     data = doc.toJson();
-    qDebug() << "Pyynnön sisältö:" << data;
+    qCDebug(lcNetwork).noquote() << "Pyynnön sisältö:" << loggableBody(data);
 
-    QNetworkReply *reply = networkManager->post(request, data);
-    connect(reply, &QNetworkReply::finished, this, [this, reply]() {
+    // Saldo ja historia ovat lukuja: identtiset käynnissä olevat pyynnöt jaetaan
+    RequestCoalescer *coalescer = RequestCoalescer::of(networkManager);
+    qint64 requestStartUs = SessionTrace::nowUs();
+    RequestCoalescer::Callback callback = [this, requestStartUs](const CoalescedReply &reply) {
+        recordSpan(this, "action_request", requestStartUs);
         onNetworkReply(reply);
-    });
+    };
+    if (actionType == Balance || actionType == History) {
+        coalescer->postShared(request, data, this, callback);
+    } else {
+        coalescer->post(request, data, this, callback);
+    }
 }
 
 void ActionWindow::onCancelButtonClicked()
 {
-    qDebug() << "Peruuta-painiketta klikattu";
+    qCDebug(lcUi) << "Peruuta-painiketta klikattu";
     emit actionFinished();
     close();
 }
 
 void ActionWindow::onCloseButtonClicked()
 {
-    qDebug() << "Sulje-painiketta klikattu";
+    qCDebug(lcUi) << "Sulje-painiketta klikattu";
     emit actionFinished();
     close();
 }
 
-void ActionWindow::onNetworkReply(QNetworkReply *reply)
+void ActionWindow::onNetworkReply(const CoalescedReply &reply)
 {
+    StallScope stallScope("ActionWindow::onNetworkReply");
+    TraceSpan span(traceOf(this), "action_reply_handler");
     QString responseText;
-    QByteArray response = reply->readAll();
-    qDebug() << "Vastaus toiminnosta:" << response;
+    qCDebug(lcNetwork).noquote() << "Vastaus toiminnosta:" << loggableBody(reply.body);
 
-    QJsonDocument doc = QJsonDocument::fromJson(response);
+    const QJsonDocument &doc = reply.doc;
     QJsonObject json = doc.object();
 
-    if (reply->error() != QNetworkReply::NoError) {
-        // Verkko- tai HTTP-virhe (esim. 400 Bad Request)
-        qDebug() << "Verkkovirhe toiminnossa:" << reply->errorString();
+    if (reply.error != QNetworkReply::NoError) {
+        // Verkko- tai HTTP-virhe (esim. 400 Bad Request): seteleitä ei anneta, joten varaus vapautetaan
+        qCDebug(lcNetwork) << "Verkkovirhe toiminnossa:" << reply.errorString;
+        releaseReservedNotes();
+        bool outcomeUnknown = actionType == Withdrawal && reply.httpStatus == 0;
+        if (outcomeUnknown) {
+            // Vastausta ei saatu: palvelin on voinut kirjata noston, joten se perutaan viitteellä
+            ClientMetrics::increment("withdrawal_outcome_unknown");
+            reverseWithdrawal();
+        }
+        withdrawalReference.clear();
         if (!doc.isNull() && json.contains("error")) {
             responseText = "Epäonnistui: " + json["error"].toString();
             // Check if the card is blocked
@@ -749,91 +1106,69 @@ void ActionWindow::onNetworkReply(QNetworkReply *reply)
                 close();
                 emit actionFinished();
                 // Show MainWindow (initial interface)
-                if (MainWindow::getInstance()) {
-                    MainWindow::getInstance()->show();
+                if (MainWindow *terminal = MainWindow::terminalOf(this)) {
+                    terminal->show();
                 }
-                reply->deleteLater();
                 return;
             }
+        } else if (outcomeUnknown) {
+            responseText = "Noston tila ei selvinnyt. Seteleitä ei annettu, ja mahdollinen veloitus perutaan.";
         } else {
-            responseText = "Virhe: " + reply->errorString();
+            responseText = "Virhe: " + reply.errorString;
         }
     } else {
         // Onnistunut vastaus (HTTP 200)
         if (actionType == Withdrawal) {
-            if (json.contains("message") && json["message"].toString() == "Withdrawal successful") {
-                QJsonObject transaction = json["transaction"].toObject();
-                double newBalance = transaction["new_balance"].toDouble();
-                responseText = QString("Onnistui! Uusi saldo: %1").arg(newBalance);
+            bool success;
+            responseText = formatWithdrawalReply(json, &success);
+            CashDispenser &dispenser = dispenserOf(this);
+            if (!success) {
+                releaseReservedNotes();
+                withdrawalReference.clear();
+            } else if (dispenser.dispense(reservedNotes)) {
+                responseText += "\nSetelit: " + dispenser.describe(reservedNotes);
+                reservedNotes = CashDispenser::NoteMix();
+                withdrawalReference.clear();
             } else {
-                QString errorMsg = json.contains("error") ? json["error"].toString() : "Tuntematon virhe";
-                responseText = "Epäonnistui: " + errorMsg;
-                // Check if the card is blocked
-                if (responseText.contains("Kortti on estetty")) {
-                    QMessageBox::warning(this, "Virhe", responseText);
-                    close();
-                    emit actionFinished();
-                    // Show MainWindow (initial interface)
-                    if (MainWindow::getInstance()) {
-                        MainWindow::getInstance()->show();
-                    }
-                    reply->deleteLater();
-                    return;
+                releaseReservedNotes();
+                ClientMetrics::increment("dispense_failed");
+                reverseWithdrawal();
+                responseText = "Setelien antaminen epäonnistui. Nosto peruttiin ja summa palautetaan tilillesi.";
+            }
+            // Check if the card is blocked
+            if (!success && responseText.contains("Kortti on estetty")) {
+                QMessageBox::warning(this, "Virhe", responseText);
+                close();
+                emit actionFinished();
+                // Show MainWindow (initial interface)
+                if (MainWindow *terminal = MainWindow::terminalOf(this)) {
+                    terminal->show();
                 }
+                return;
             }
         } else if (actionType == TopUp) {
-            if (json.contains("success") && json["success"].toBool()) {
-                double newBalance = json["newBalance"].toDouble();
-                responseText = QString("Toiminto onnistui!\nUusi saldo: %1").arg(newBalance);
+            bool success;
+            double newBalance;
+            responseText = formatTopUpReply(json, &success, &newBalance);
+            if (success) {
                 ConfirmationWindow *confirmationWindow = new ConfirmationWindow(responseText, newBalance, welcomeWindow, nullptr);
                 connect(confirmationWindow, &ConfirmationWindow::topUpCompleted, welcomeWindow, [this]() {
                     welcomeWindow->show();
                     emit actionFinished();
                 });
                 confirmationWindow->show();
-                reply->deleteLater();
                 return; // Poistu aikaisin
             } else {
-                QString errorMsg = json.contains("error") ? json["error"].toString() : "Tuntematon virhe";
-                responseText = "Epäonnistui: " + errorMsg;
                 // Talletuksen epäonnistuessa näytä virhe ja palaa WelcomeWindow-ikkunaan
                 QMessageBox::warning(welcomeWindow, "Talletus", responseText);
                 welcomeWindow->show();
                 emit actionFinished();
-                reply->deleteLater();
                 return;
             }
         } else if (actionType == Balance) {
-            if (json.contains("message") && json["message"].toString() == "Balance retrieved successfully") {
-                double balance = json["balance"].toDouble();
-                responseText = QString("Saldosi: %1").arg(balance);
-            } else {
-                QString errorMsg = json.contains("error") ? json["error"].toString() : "Tuntematon virhe";
-                responseText = "Epäonnistui: " + errorMsg;
-            }
+            responseText = formatBalanceReply(json);
         } else { // Historia
-            if (doc.isArray()) {
-                QJsonArray transactions = doc.array();
-                QStringList transactionList;
-                for (const QJsonValue &value : transactions) {
-                    QJsonObject tx = value.toObject();
-                    double amount = tx["summa"].toDouble();
-                    QString type = amount < 0 ? "Nosto" : "Talletus";
-                    QString dateTime = QDateTime::fromString(tx["transaction_time"].toString(), Qt::ISODate)
-                                           .toString("yyyy-MM-dd HH:mm:ss");
-                    QString entry = QString("ID: %1, Tyyppi: %2, Summa: %3, Aika: %4")
-                                        .arg(tx["transaction_id"].toInt())
-                                        .arg(type)
-                                        .arg(amount, 0, 'f', 2)
-                                        .arg(dateTime);
-                    transactionList << entry;
-                }
-                responseText = transactionList.join("\n");
-                if (responseText.isEmpty()) responseText = "Ei tapahtumia.";
-            } else {
-                QString errorMsg = json.contains("error") ? json["error"].toString() : "Tuntematon virhe";
-                responseText = "Epäonnistui: " + errorMsg;
-            }
+            responseText = formatHistoryReply(doc);
         }
     }
 
@@ -848,8 +1183,6 @@ void ActionWindow::onNetworkReply(QNetworkReply *reply)
         // Päivitä teksti Saldolle tai Historielle
         resultLabel->setText(responseText);
     }
-
-    reply->deleteLater();
 }
 
 // ConfirmationWindow toteutus
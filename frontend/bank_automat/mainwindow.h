@@ -5,6 +5,7 @@
 #include <QLabel>
 #include <QLibrary>
 #include <QNetworkAccessManager>
+#include <QNetworkCookieJar>
 #include <QNetworkReply>
 #include <QLineEdit>
 #include <QGridLayout>
@@ -16,9 +17,17 @@
 #include <QMessageBox>
 #include <QApplication>
 #include <QTimer>
+#include <QPointer>
+#include "cashdispenser.h"
+#include "requestcoalescer.h"
+#include "sessiontrace.h"
 
 typedef void (*PrintDebugMessageFunc)();
 typedef void (*SetCardReadCallbackFunc)(void (*callback)(const char*));
+// Valinnainen monilukijarajapinta: kirjasto kutsuu takaisinkutsua lukijan tunnisteella (sama
+// merkkijono kuin InitReaderille) ja korttinumerolla. Jos kirjasto ei vie tätä funktiota,
+// tapahtumaa ei voi kohdistaa lukijalle ja vain yksi pääte (ATM_READERS) voi olla käytössä.
+typedef void (*SetReaderCardReadCallbackFunc)(void (*callback)(const char *readerId, const char *cardNumber));
 typedef bool (*InitReaderFunc)(const char*);
 typedef void (*StartCardReadingFunc)();
 typedef void (*StopCardReadingFunc)();
@@ -33,26 +42,51 @@ class MainWindow : public QMainWindow
 {
     Q_OBJECT
 public:
-    explicit MainWindow(QWidget *parent = nullptr);
+    explicit MainWindow(const QString &readerId = "COM3", QWidget *parent = nullptr);
     ~MainWindow();
 
-
-    static MainWindow* getInstance();
+    // Pääte, jonka ikkunapuuhun olio kuuluu (nullptr, jos ei mihinkään)
+    static MainWindow* terminalOf(QObject *object);
 
     static void cardReadCallback(const char* cardNumber);
+    static void readerCardReadCallback(const char *readerId, const char *cardNumber);
+
+    // Korttitapahtuma tälle päätteelle (TerminalRegistry kutsuu GUI-säikeessä)
+    void handleCardRead(const QString &cardNumber);
+
+    QString readerId() const { return reader; }
+    QNetworkCookieJar *cookieJar() const { return cookies; }
+
+    // Päätteen omat kasetit ja jäljitysistunto; päätteen ikkunat käyttävät näitä
+    CashDispenser &cashDispenser() { return dispenser; }
+    SessionTrace &sessionTrace() { return trace; }
 
 public slots:
     void show();
 
+protected:
+    bool event(QEvent *event) override;
+
 private slots:
     void onAuthenticationCompleted(const QString &firstName, const QString &lastName, int accountId, const QString &cardNumber, const QString &pinCode, const QString &token, const QString &cardType);
+    void initializeDeferred();
+    void onReaderInitialized();
+    void endCustomerSession();
 
 private:
-    static MainWindow* instance;
+    QString loadReader();
+
+    QString reader;
+    CashDispenser dispenser;
+    SessionTrace trace;
     QString lastCardNumber;
     QLabel *statusLabel;
     QLibrary *rfidLibrary;
     QNetworkAccessManager *networkManager;
+    QNetworkCookieJar *cookies;
+    bool idleScreenPainted;
+    bool readerInitQueued;
+    QString readerError;
 
     PrintDebugMessageFunc PrintDebugMessage;
     SetCardReadCallbackFunc SetCardReadCallback;
@@ -75,10 +109,10 @@ private slots:
     void onNumberButtonClicked(const QString &number);
     void onClearButtonClicked();
     void onSubmitButtonClicked();
-    void onNetworkReply(QNetworkReply *reply);
     void updateTimer();
 
 private:
+    void onNetworkReply(const CoalescedReply &reply);
     void resetPinInput();
     QString cardNumber;
     QString pinCode;
@@ -88,6 +122,7 @@ private:
     int failedAttempts;
     QTimer *timer;
     int timeRemaining;
+    qint64 shownAtUs;
 };
 
 class WelcomeWindow : public QMainWindow
@@ -97,8 +132,16 @@ public:
     WelcomeWindow(const QString &firstName, const QString &lastName, int accountId, const QString &cardNumber, const QString &pinCode, const QString &token, const QString &cardType, QNetworkAccessManager *sharedNetworkManager, QWidget *parent = nullptr);
     ~WelcomeWindow();
 
+    // Jäljellä oleva nostoraja euroina, -1 jos sitä ei ole vielä haettu
+    double remainingWithdrawalLimit() const { return withdrawalLimit; }
+
 signals:
     void actionCompleted();
+    // Asiakkaan istunto päättyy, kun tervetuloikkuna suljetaan
+    void sessionEnded();
+
+protected:
+    void closeEvent(QCloseEvent *event) override;
 
 private slots:
     void onWithdrawalClicked();
@@ -107,6 +150,8 @@ private slots:
     void onHistoryClicked();
 
 private:
+    void fetchWithdrawalLimit();
+
     QString firstName;
     QString lastName;
     int accountId;
@@ -115,6 +160,7 @@ private:
     QString token;
     QString cardType;
     QNetworkAccessManager *networkManager;
+    double withdrawalLimit;
 };
 
 class ActionWindow : public QMainWindow
@@ -136,9 +182,12 @@ private slots:
     void performAction();
     void onCancelButtonClicked();
     void onCloseButtonClicked();
-    void onNetworkReply(QNetworkReply *reply);
 
 private:
+    void onNetworkReply(const CoalescedReply &reply);
+    void releaseReservedNotes();
+    void reverseWithdrawal();
+
     ActionType actionType;
     int accountId;
     QString cardNumber;
@@ -148,7 +197,10 @@ private:
     QLineEdit *amountInput;
     QLabel *resultLabel;
     double pendingAmount;
+    CashDispenser::NoteMix reservedNotes;
+    QByteArray withdrawalReference;
     WelcomeWindow *welcomeWindow;
+    qint64 reAuthStartUs;
 };
 
 class ConfirmationWindow : public QMainWindow
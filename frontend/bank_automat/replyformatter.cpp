@@ -0,0 +1,162 @@
+#include "replyformatter.h"
+#include <QJsonArray>
+#include <QJsonValue>
+#include <QDateTime>
+
+AuthReply parseAuthReply(const QJsonObject &json)
+{
+    AuthReply auth;
+    auth.valid = false;
+    auth.accountId = -1;
+
+    QJsonObject::const_iterator customerIt = json.constFind("customer");
+    if (customerIt == json.constEnd() || !customerIt->isObject()) {
+        auth.error = "Vastauksesta puuttuu 'customer'-objekti";
+        return auth;
+    }
+
+    QJsonObject customer = customerIt->toObject();
+    QJsonObject::const_iterator firstNameIt = customer.constFind("first_name");
+    QJsonObject::const_iterator lastNameIt = customer.constFind("last_name");
+    if (firstNameIt == customer.constEnd() || lastNameIt == customer.constEnd()) {
+        auth.error = "Vastauksesta puuttuu 'first_name' tai 'last_name' asiakasobjektissa";
+        return auth;
+    }
+
+    QJsonObject::const_iterator accountIt = json.constFind("account_id");
+    if (accountIt == json.constEnd()) {
+        auth.error = "Vastauksesta puuttuu 'account_id'";
+        return auth;
+    }
+
+    QJsonObject::const_iterator cardTypeIt = json.constFind("card_type");
+    if (cardTypeIt == json.constEnd()) {
+        auth.error = "Vastauksesta puuttuu 'card_type'";
+        return auth;
+    }
+
+    auth.valid = true;
+    auth.firstName = firstNameIt->toString();
+    auth.lastName = lastNameIt->toString();
+    auth.accountId = accountIt->toInt();
+    auth.cardType = cardTypeIt->toString();
+    return auth;
+}
+
+double jsonAmount(const QJsonValue &value)
+{
+    if (value.isString()) {
+        return value.toString().toDouble();
+    }
+    return value.toDouble();
+}
+
+QString formatFailureText(const QJsonObject &json)
+{
+    QJsonObject::const_iterator errorIt = json.constFind("error");
+    QString errorMsg = errorIt != json.constEnd() ? errorIt->toString() : QString("Tuntematon virhe");
+    return "Epäonnistui: " + errorMsg;
+}
+
+QString formatWithdrawalReply(const QJsonObject &json, bool *success)
+{
+    *success = json.value("message").toString() == QLatin1String("Withdrawal successful");
+    if (!*success) {
+        return formatFailureText(json);
+    }
+    double newBalance = jsonAmount(json.value("transaction").toObject().value("new_balance"));
+    return QString("Onnistui! Uusi saldo: %1").arg(newBalance);
+}
+
+QString formatTopUpReply(const QJsonObject &json, bool *success, double *newBalance)
+{
+    *success = json.value("success").toBool();
+    if (!*success) {
+        *newBalance = 0.0;
+        return formatFailureText(json);
+    }
+    *newBalance = jsonAmount(json.value("newBalance"));
+    return QString("Toiminto onnistui!\nUusi saldo: %1").arg(*newBalance);
+}
+
+QString formatBalanceReply(const QJsonObject &json)
+{
+    if (json.value("message").toString() != QLatin1String("Balance retrieved successfully")) {
+        return formatFailureText(json);
+    }
+    QString text = QString("Saldosi: %1").arg(jsonAmount(json.value("balance")));
+    // Luottokortilla näytetään myös luottorajasta jäljellä oleva nostettava määrä
+    if (json.value("card_type").toString() == QLatin1String("credit") && json.contains("available")) {
+        text += QString("\nNostettavissa: %1").arg(jsonAmount(json.value("available")));
+    }
+    return text;
+}
+
+static bool isDigitAt(const QString &text, int index)
+{
+    ushort c = text.at(index).unicode();
+    return c >= '0' && c <= '9';
+}
+
+static int numberAt(const QString &text, int index, int length)
+{
+    int value = 0;
+    for (int i = index; i < index + length; ++i) {
+        value = value * 10 + (text.at(i).unicode() - '0');
+    }
+    return value;
+}
+
+QString formatTransactionTime(const QString &isoTime)
+{
+    // Nopea polku: ISO-aikaleiman numerot ovat samat kuin muotoillussa tuloksessa,
+    // koska QDateTime säilyttää aikaleiman oman aikavyöhykkeen. Vältetään jäsennys.
+    static const int digitPositions[] = { 0, 1, 2, 3, 5, 6, 8, 9, 11, 12, 14, 15, 17, 18 };
+    if (isoTime.size() >= 19 && isoTime.at(4) == QLatin1Char('-') && isoTime.at(7) == QLatin1Char('-')
+        && isoTime.at(10) == QLatin1Char('T') && isoTime.at(13) == QLatin1Char(':') && isoTime.at(16) == QLatin1Char(':')) {
+        bool digits = true;
+        for (int position : digitPositions) {
+            digits = digits && isDigitAt(isoTime, position);
+        }
+        if (digits && QDate::isValid(numberAt(isoTime, 0, 4), numberAt(isoTime, 5, 2), numberAt(isoTime, 8, 2))
+            && QTime::isValid(numberAt(isoTime, 11, 2), numberAt(isoTime, 14, 2), numberAt(isoTime, 17, 2))) {
+            QString result = isoTime.left(19);
+            result[10] = QLatin1Char(' ');
+            return result;
+        }
+    }
+
+    return QDateTime::fromString(isoTime, Qt::ISODate).toString("yyyy-MM-dd HH:mm:ss");
+}
+
+QString formatHistoryReply(const QJsonDocument &doc)
+{
+    if (!doc.isArray()) {
+        return formatFailureText(doc.object());
+    }
+
+    QJsonArray transactions = doc.array();
+    if (transactions.isEmpty()) {
+        return "Ei tapahtumia.";
+    }
+
+    // Yksi puskuri koko listalle .arg()-ketjujen ja QStringList::join-kopioiden sijaan
+    QString text;
+    text.reserve(transactions.size() * 72);
+    for (const QJsonValue &value : transactions) {
+        QJsonObject tx = value.toObject();
+        double amount = jsonAmount(tx.value("summa"));
+        if (!text.isEmpty()) {
+            text += QLatin1Char('\n');
+        }
+        text += QLatin1String("ID: ");
+        text += QString::number(tx.value("transaction_id").toInt());
+        text += QLatin1String(", Tyyppi: ");
+        text += amount < 0 ? QLatin1String("Nosto") : QLatin1String("Talletus");
+        text += QLatin1String(", Summa: ");
+        text += QString::number(amount, 'f', 2);
+        text += QLatin1String(", Aika: ");
+        text += formatTransactionTime(tx.value("transaction_time").toString());
+    }
+    return text;
+}
@@ -0,0 +1,41 @@
+#ifndef REPLYFORMATTER_H
+#define REPLYFORMATTER_H
+
+#include <QString>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonValue>
+
+// Vastausten jäsennys ja muotoilu erotettuna ikkunoista, jotta niitä voidaan mitata
+// (bank_automat_bench) ilman verkkoa tai käyttöliittymää.
+
+struct AuthReply
+{
+    bool valid;
+    QString error;
+    QString firstName;
+    QString lastName;
+    int accountId;
+    QString cardType;
+};
+
+// Jäsentää onnistuneen /cards/auth-vastauksen; valid == false, jos kenttiä puuttuu
+AuthReply parseAuthReply(const QJsonObject &json);
+
+// Rahasumma JSON-arvosta: mysql2 palauttaa DECIMAL-sarakkeet merkkijonoina ("-40.00"),
+// joille QJsonValue::toDouble() antaisi 0; laskettu arvo voi olla myös luku
+double jsonAmount(const QJsonValue &value);
+
+// "Epäonnistui: <error>" tai "Epäonnistui: Tuntematon virhe"
+QString formatFailureText(const QJsonObject &json);
+
+// Palauttaa tekstin ja asettaa success-lipun vastauksen viestin perusteella
+QString formatWithdrawalReply(const QJsonObject &json, bool *success);
+QString formatTopUpReply(const QJsonObject &json, bool *success, double *newBalance);
+QString formatBalanceReply(const QJsonObject &json);
+QString formatHistoryReply(const QJsonDocument &doc);
+
+// ISO 8601 -aikaleima muotoon "yyyy-MM-dd HH:mm:ss"
+QString formatTransactionTime(const QString &isoTime);
+
+#endif // REPLYFORMATTER_H
@@ -0,0 +1,150 @@
+#include "requestcoalescer.h"
+#include "asynclogger.h"
+#include "clientmetrics.h"
+#include "sessiontrace.h"
+#include "trafficrecorder.h"
+#include <QCryptographicHash>
+#include <QNetworkCookie>
+#include <QHostInfo>
+
+QByteArray RequestCoalescer::atmId()
+{
+    static const QByteArray id = qEnvironmentVariableIsSet("ATM_ID")
+        ? qgetenv("ATM_ID")
+        : QHostInfo::localHostName().toUtf8();
+    return id;
+}
+
+RequestCoalescer::RequestCoalescer(QNetworkAccessManager *manager)
+    : QObject(manager), manager(manager), defaultLimit(2), coalesced(0), uniqueCounter(0)
+{
+    setObjectName("RequestCoalescer");
+}
+
+RequestCoalescer* RequestCoalescer::of(QNetworkAccessManager *manager)
+{
+    RequestCoalescer *coalescer = manager->findChild<RequestCoalescer*>("RequestCoalescer", Qt::FindDirectChildrenOnly);
+    if (!coalescer) {
+        coalescer = new RequestCoalescer(manager);
+    }
+    return coalescer;
+}
+
+void RequestCoalescer::setEndpointLimit(const QString &path, int limit)
+{
+    endpointLimits[path] = limit;
+}
+
+int RequestCoalescer::limitFor(const QString &path) const
+{
+    return endpointLimits.value(path, defaultLimit);
+}
+
+void RequestCoalescer::postShared(const QNetworkRequest &request, const QByteArray &data, QObject *context, Callback callback)
+{
+    // Avain: osoite + evästeet + runko, joten eri tilien ja päätteiden pyynnöt eivät sekoitu
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(request.url().toEncoded());
+    hash.addData(request.rawHeader("Cookie"));
+    hash.addData(data);
+    QByteArray key = hash.result();
+
+    Waiter waiter = { context, callback };
+    auto it = waiters.find(key);
+    if (it != waiters.end()) {
+        // Sama pyyntö on jo matkalla, liitytään odottajaksi
+        it->append(waiter);
+        coalesced++;
+        qCDebug(lcNetwork) << "Yhdistetty käynnissä olevaan pyyntöön:" << request.url().path();
+        return;
+    }
+
+    waiters.insert(key, QList<Waiter>() << waiter);
+    enqueue(key, request, data);
+}
+
+void RequestCoalescer::post(const QNetworkRequest &request, const QByteArray &data, QObject *context, Callback callback)
+{
+    QByteArray key = "u:" + QByteArray::number(++uniqueCounter);
+    Waiter waiter = { context, callback };
+    waiters.insert(key, QList<Waiter>() << waiter);
+    enqueue(key, request, data);
+}
+
+void RequestCoalescer::enqueue(const QByteArray &key, const QNetworkRequest &request, const QByteArray &data)
+{
+    QString path = request.url().path();
+    if (activeCount.value(path) < limitFor(path)) {
+        start(key, request, data);
+    } else {
+        PendingRequest pending = { key, request, data };
+        queued[path].enqueue(pending);
+        ClientMetrics::increment("requests_queued");
+    }
+}
+
+void RequestCoalescer::start(const QByteArray &key, const QNetworkRequest &request, const QByteArray &data)
+{
+    QString path = request.url().path();
+    activeCount[path]++;
+    ClientMetrics::increment("requests_in_flight");
+
+    QNetworkRequest outgoing(request);
+    outgoing.setRawHeader("X-ATM-Id", atmId());
+
+    // Päätekohtainen evästevarasto, jos pyyntö hallitsee evästeensä itse (jaettu verkkomanageri)
+    QPointer<QNetworkCookieJar> cookieJar = qobject_cast<QNetworkCookieJar*>(request.attribute(QNetworkRequest::User).value<QObject*>());
+
+    qint64 startUs = SessionTrace::nowUs();
+    QNetworkReply *reply = manager->post(outgoing, data);
+    connect(reply, &QNetworkReply::finished, this, [this, key, request, data, startUs, cookieJar, reply]() {
+        onFinished(key, request, data, startUs, cookieJar, reply);
+    });
+}
+
+void RequestCoalescer::onFinished(const QByteArray &key, const QNetworkRequest &request, const QByteArray &data, qint64 startUs, QPointer<QNetworkCookieJar> cookieJar, QNetworkReply *reply)
+{
+    QString path = request.url().path();
+    CoalescedReply result;
+    result.error = reply->error();
+    result.errorString = reply->errorString();
+    result.httpStatus = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    result.body = reply->readAll();
+    result.doc = QJsonDocument::fromJson(result.body);
+    if (cookieJar) {
+        QVariant cookies = reply->header(QNetworkRequest::SetCookieHeader);
+        if (cookies.isValid()) {
+            cookieJar->setCookiesFromUrl(cookies.value<QList<QNetworkCookie>>(), reply->url());
+        }
+    }
+    reply->deleteLater();
+
+    // Kumulatiiviset laskurit; telemetria laskee niistä välikohtaiset arvot
+    ClientMetrics::increment("requests_in_flight", -1);
+    ClientMetrics::increment("request_count");
+    ClientMetrics::increment("request_latency_us_total", SessionTrace::nowUs() - startUs);
+    if (result.error != QNetworkReply::NoError) {
+        ClientMetrics::increment("request_errors");
+    }
+
+    if (TrafficRecorder::isEnabled()) {
+        TrafficRecorder::record(request.rawHeader("X-Trace-Id"), request, data, result, startUs, SessionTrace::nowUs());
+    }
+
+    activeCount[path]--;
+    QList<Waiter> finished = waiters.take(key);
+
+    // Käynnistä jonossa olevat ennen takaisinkutsuja, koska ne voivat avata modaalisia ikkunoita
+    QQueue<PendingRequest> &queue = queued[path];
+    while (!queue.isEmpty() && activeCount.value(path) < limitFor(path)) {
+        PendingRequest next = queue.dequeue();
+        ClientMetrics::increment("requests_queued", -1);
+        start(next.key, next.request, next.data);
+    }
+
+    for (const Waiter &waiter : finished) {
+        if (waiter.context) {
+            waiter.callback(result);
+        }
+    }
+}
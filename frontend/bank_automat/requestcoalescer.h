@@ -0,0 +1,81 @@
+#ifndef REQUESTCOALESCER_H
+#define REQUESTCOALESCER_H
+
+#include <QObject>
+#include <QNetworkAccessManager>
+#include <QNetworkCookieJar>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QJsonDocument>
+#include <QHash>
+#include <QList>
+#include <QPointer>
+#include <QQueue>
+#include <functional>
+
+// Valmiiksi luettu ja jäsennetty vastaus, joka jaetaan kaikille odottajille
+struct CoalescedReply
+{
+    QNetworkReply::NetworkError error;
+    QString errorString;
+    int httpStatus;
+    QByteArray body;
+    QJsonDocument doc;
+};
+
+// Yhdistää identtiset samanaikaiset lukupyynnöt yhdeksi QNetworkReplyksi
+// ja rajoittaa samanaikaisten pyyntöjen määrää päätepistettä kohden.
+class RequestCoalescer : public QObject
+{
+    Q_OBJECT
+public:
+    typedef std::function<void(const CoalescedReply &)> Callback;
+
+    explicit RequestCoalescer(QNetworkAccessManager *manager);
+
+    // Palauttaa verkkomanagerin jaetun instanssin (luodaan tarvittaessa managerin lapseksi)
+    static RequestCoalescer* of(QNetworkAccessManager *manager);
+
+    // Automaatin tunniste backendille ja telemetrialle: ATM_ID tai koneen nimi
+    static QByteArray atmId();
+
+    // Lukupyyntö: identtinen käynnissä oleva pyyntö jaetaan, uutta ei lähetetä
+    void postShared(const QNetworkRequest &request, const QByteArray &data, QObject *context, Callback callback);
+
+    // Kirjoittava pyyntö: ei jaeta, mutta noudattaa päätepisteen rajaa
+    void post(const QNetworkRequest &request, const QByteArray &data, QObject *context, Callback callback);
+
+    void setEndpointLimit(const QString &path, int limit);
+    void setDefaultLimit(int limit) { defaultLimit = limit; }
+    int coalescedCount() const { return coalesced; }
+
+private:
+    struct Waiter
+    {
+        QPointer<QObject> context;
+        Callback callback;
+    };
+
+    struct PendingRequest
+    {
+        QByteArray key;
+        QNetworkRequest request;
+        QByteArray data;
+    };
+
+    void enqueue(const QByteArray &key, const QNetworkRequest &request, const QByteArray &data);
+    void start(const QByteArray &key, const QNetworkRequest &request, const QByteArray &data);
+    void onFinished(const QByteArray &key, const QNetworkRequest &request, const QByteArray &data, qint64 startUs, QPointer<QNetworkCookieJar> cookieJar, QNetworkReply *reply);
+    int limitFor(const QString &path) const;
+
+    QNetworkAccessManager *manager;
+    QHash<QByteArray, QList<Waiter>> waiters;
+    QHash<QString, int> activeCount;
+    QHash<QString, int> endpointLimits;
+    QHash<QString, QQueue<PendingRequest>> queued;
+    int defaultLimit;
+    int coalesced;
+    quint64 uniqueCounter;
+};
+
+#endif // REQUESTCOALESCER_H
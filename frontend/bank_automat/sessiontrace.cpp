@@ -0,0 +1,217 @@
+#include "sessiontrace.h"
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRandomGenerator>
+#include <QThread>
+#include <atomic>
+#include <vector>
+
+namespace {
+
+// Paikan kentät ovat atomisia (relaxed), jotta tyhjennys voi lukea niitä kirjoituksen
+// aikana; sequence kertoo, mikä kirjoitus paikassa on (pariton = kesken), session
+// minkä istunnon span on
+struct SpanRecord
+{
+    std::atomic<quint32> sequence;
+    std::atomic<quint32> session;
+    std::atomic<const char *> name;
+    std::atomic<qint64> startUs;
+    std::atomic<qint64> durationUs;
+};
+
+// Kahden potenssi, jotta indeksi saadaan maskilla
+const quint32 RingSize = 1024;
+
+// Vain omistajasäie kirjoittaa; head julkaistaan release-järjestyksellä tyhjennystä varten.
+// Tyhjennys voi silti osua paikkaan, jota rengas on juuri kierrättämässä, joten jokainen
+// paikka tarkistetaan sen sequence-numerosta ennen ja jälkeen lukemisen (seqlock).
+struct ThreadRing
+{
+    SpanRecord spans[RingSize];
+    std::atomic<quint32> head;
+    quint64 threadId;
+};
+
+QMutex registryMutex;
+std::vector<ThreadRing *> registry;
+thread_local ThreadRing *localRing = nullptr;
+
+// Istuntojen numerot koko prosessissa; 0 tarkoittaa, ettei istuntoa ole
+std::atomic<quint32> lastSerial(0);
+
+// Kirjoituksen i valmis sequence-arvo; 0 tarkoittaa, ettei paikkaan ole kirjoitettu
+inline quint32 committedSequence(quint32 index)
+{
+    return 2 * index + 2;
+}
+
+ThreadRing *ringForThread()
+{
+    if (!localRing) {
+        // Renkaat elävät prosessin loppuun asti, joten tyhjennys voi lukea niitä turvallisesti
+        localRing = new ThreadRing;
+        localRing->head.store(0, std::memory_order_relaxed);
+        for (SpanRecord &span : localRing->spans) {
+            span.sequence.store(0, std::memory_order_relaxed);
+        }
+        localRing->threadId = reinterpret_cast<quintptr>(QThread::currentThreadId());
+        QMutexLocker locker(&registryMutex);
+        registry.push_back(localRing);
+    }
+    return localRing;
+}
+
+struct TraceClock
+{
+    qint64 epochBaseUs;
+    QElapsedTimer timer;
+
+    TraceClock()
+    {
+        epochBaseUs = QDateTime::currentMSecsSinceEpoch() * 1000;
+        timer.start();
+    }
+};
+
+TraceClock &traceClock()
+{
+    static TraceClock clock;
+    return clock;
+}
+
+const QByteArray &traceDirectory()
+{
+    static const QByteArray directory = qgetenv("ATM_TRACE_DIR");
+    return directory;
+}
+
+} // namespace
+
+qint64 SessionTrace::nowUs()
+{
+    TraceClock &clock = traceClock();
+    return clock.epochBaseUs + clock.timer.nsecsElapsed() / 1000;
+}
+
+SessionTrace::SessionTrace()
+    : serial(0)
+{
+}
+
+void SessionTrace::beginSession()
+{
+    quint64 high = QRandomGenerator::global()->generate64();
+    quint64 low = QRandomGenerator::global()->generate64();
+    QByteArray traceId = QByteArray::number(high, 16).rightJustified(16, '0')
+                         + QByteArray::number(low, 16).rightJustified(16, '0');
+
+    QMutexLocker locker(&mutex);
+    currentTraceId = traceId;
+    serial = lastSerial.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+QByteArray SessionTrace::traceId() const
+{
+    QMutexLocker locker(&mutex);
+    return currentTraceId;
+}
+
+void SessionTrace::record(const char *name, qint64 startUs, qint64 endUs)
+{
+    quint32 session;
+    {
+        QMutexLocker locker(&mutex);
+        session = serial;
+    }
+    if (session == 0) {
+        return;
+    }
+
+    ThreadRing *ring = ringForThread();
+    quint32 head = ring->head.load(std::memory_order_relaxed);
+    SpanRecord &span = ring->spans[head & (RingSize - 1)];
+    span.sequence.store(committedSequence(head) - 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    span.session.store(session, std::memory_order_relaxed);
+    span.name.store(name, std::memory_order_relaxed);
+    span.startUs.store(startUs, std::memory_order_relaxed);
+    span.durationUs.store(endUs - startUs, std::memory_order_relaxed);
+    span.sequence.store(committedSequence(head), std::memory_order_release);
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+void SessionTrace::endSession()
+{
+    // Istunto otetaan talteen ja nollataan kerralla, jotta samanaikainen aloitus ei sekoitu
+    QByteArray traceId;
+    quint32 session;
+    {
+        QMutexLocker sessionLocker(&mutex);
+        traceId = currentTraceId;
+        session = serial;
+        currentTraceId.clear();
+        serial = 0;
+    }
+    if (traceId.isEmpty()) {
+        return;
+    }
+
+    if (!traceDirectory().isEmpty()) {
+        QJsonArray events;
+        QString traceIdText = QString::fromLatin1(traceId);
+        qint64 pid = QCoreApplication::applicationPid();
+
+        QMutexLocker locker(&registryMutex);
+        for (ThreadRing *ring : registry) {
+            quint32 head = ring->head.load(std::memory_order_acquire);
+            quint32 first = head > RingSize ? head - RingSize : 0;
+            for (quint32 i = first; i < head; ++i) {
+                // Ohitetaan paikat, jotka on jo kierrätetty tai joiden kirjoitus on kesken
+                const SpanRecord &span = ring->spans[i & (RingSize - 1)];
+                if (span.sequence.load(std::memory_order_acquire) != committedSequence(i)) {
+                    continue;
+                }
+                quint32 spanSession = span.session.load(std::memory_order_relaxed);
+                const char *name = span.name.load(std::memory_order_relaxed);
+                qint64 spanStartUs = span.startUs.load(std::memory_order_relaxed);
+                qint64 durationUs = span.durationUs.load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (span.sequence.load(std::memory_order_relaxed) != committedSequence(i)) {
+                    continue;
+                }
+                if (spanSession != session) {
+                    continue;
+                }
+                QJsonObject event;
+                event["name"] = QString::fromLatin1(name);
+                event["cat"] = "atm";
+                event["ph"] = "X";
+                event["ts"] = spanStartUs;
+                event["dur"] = durationUs;
+                event["pid"] = pid;
+                event["tid"] = static_cast<qint64>(ring->threadId);
+                event["args"] = QJsonObject{ { "trace_id", traceIdText } };
+                events.append(event);
+            }
+        }
+        locker.unlock();
+
+        QDir directory(QString::fromLocal8Bit(traceDirectory()));
+        QFile file(directory.filePath("trace-" + traceIdText + ".json"));
+        if (file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            file.write(QJsonDocument(QJsonObject{ { "traceEvents", events } }).toJson(QJsonDocument::Compact));
+        } else {
+            qDebug() << "Jäljitystiedoston kirjoitus epäonnistui:" << file.fileName();
+        }
+    }
+}
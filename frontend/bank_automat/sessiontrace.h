@@ -0,0 +1,61 @@
+#ifndef SESSIONTRACE_H
+#define SESSIONTRACE_H
+
+#include <QByteArray>
+#include <QMutex>
+#include <QString>
+#include <QtGlobal>
+
+// Kevyt istuntokohtainen jäljitys (kortin luku -> viimeinen vastaus), yksi olio päätettä kohden.
+// Spanit kirjoitetaan säiekohtaiseen rengaspuskuriin ilman lukkoja istunnon numerolla
+// merkittyinä ja tyhjennetään Chrome trace-event JSON -tiedostoksi istunnon päättyessä,
+// jos ATM_TRACE_DIR on asetettu. Saman prosessin päätteiden istunnot eivät sekoitu.
+class SessionTrace
+{
+public:
+    SessionTrace();
+
+    // Aloittaa uuden istunnon ja arpoo sille jäljitystunnisteen
+    void beginSession();
+
+    // Kirjoittaa istunnon spanit tiedostoon ja nollaa tunnisteen
+    void endSession();
+
+    // Lähetetään X-Trace-Id-otsakkeessa, jotta backendin spanit liittyvät samaan jäljitykseen
+    QByteArray traceId() const;
+
+    // Kirjaa valmiin spanin tähän istuntoon; nimen on oltava merkkijonoliteraali
+    void record(const char *name, qint64 startUs, qint64 endUs);
+
+    // Aikaleima mikrosekunteina epochista (sama aikakanta kuin backendilla)
+    static qint64 nowUs();
+
+private:
+    Q_DISABLE_COPY(SessionTrace)
+
+    // Tunniste kirjoitetaan ja luetaan eri säikeistä, joten se suojataan lukolla
+    mutable QMutex mutex;
+    QByteArray currentTraceId;
+    quint32 serial;
+};
+
+// Mittaa näkyvyysalueen keston; trace voi olla nullptr (ikkuna ei kuulu päätteeseen)
+class TraceSpan
+{
+public:
+    TraceSpan(SessionTrace *trace, const char *name) : trace(trace), name(name), startUs(SessionTrace::nowUs()) {}
+    ~TraceSpan()
+    {
+        if (trace) {
+            trace->record(name, startUs, SessionTrace::nowUs());
+        }
+    }
+
+private:
+    Q_DISABLE_COPY(TraceSpan)
+    SessionTrace *trace;
+    const char *name;
+    qint64 startUs;
+};
+
+#endif // SESSIONTRACE_H
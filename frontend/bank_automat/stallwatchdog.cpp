@@ -0,0 +1,81 @@
+#include "stallwatchdog.h"
+#include "clientmetrics.h"
+#include <QDebug>
+
+std::atomic<const char *> StallWatchdog::activeHandler(nullptr);
+
+StallWatchdog::StallWatchdog(int thresholdMs, QObject *parent)
+    : QObject(parent), thresholdMs(thresholdMs), heartbeat(new QTimer(this)), lastBeatMs(0), stopping(false)
+{
+    connect(heartbeat, &QTimer::timeout, this, &StallWatchdog::beat);
+}
+
+StallWatchdog::~StallWatchdog()
+{
+    stopping.store(true);
+    if (monitorThread) {
+        monitorThread->wait();
+    }
+}
+
+void StallWatchdog::start()
+{
+    clock.start();
+    lastBeatMs.store(0);
+    heartbeat->start(HeartbeatIntervalMs);
+
+    monitorThread = QThread::create([this]() {
+        monitor();
+    });
+    connect(monitorThread, &QThread::finished, monitorThread, &QObject::deleteLater);
+    monitorThread->start();
+}
+
+void StallWatchdog::beat()
+{
+    lastBeatMs.store(clock.elapsed(), std::memory_order_release);
+}
+
+void StallWatchdog::monitor()
+{
+    bool stalled = false;
+    qint64 stallStartBeat = 0;
+    const char *stallHandler = nullptr;
+
+    while (!stopping.load()) {
+        QThread::msleep(HeartbeatIntervalMs / 2);
+
+        qint64 last = lastBeatMs.load(std::memory_order_acquire);
+        qint64 gap = clock.elapsed() - last;
+
+        if (!stalled && gap > HeartbeatIntervalMs + thresholdMs) {
+            // Näytteistä käsittelijä jumin aikana, ei vasta sen jälkeen
+            stalled = true;
+            stallStartBeat = last;
+            stallHandler = activeHandler.load(std::memory_order_relaxed);
+        } else if (stalled && last != stallStartBeat) {
+            stalled = false;
+            recordStall(last - stallStartBeat - HeartbeatIntervalMs, stallHandler);
+        }
+    }
+}
+
+void StallWatchdog::recordStall(qint64 durationMs, const char *handler)
+{
+    static const int bucketLimitsMs[] = { 500, 1000, 2000, 5000 };
+    QString bucket = "gui_stall_over_5000ms";
+    for (int limit : bucketLimitsMs) {
+        if (durationMs <= limit) {
+            bucket = QString("gui_stall_le_%1ms").arg(limit);
+            break;
+        }
+    }
+
+    QString handlerName = handler ? QString::fromLatin1(handler) : QString("tuntematon");
+    ClientMetrics::increment("gui_stall_count");
+    ClientMetrics::increment("gui_stall_total_ms", durationMs);
+    ClientMetrics::increment(bucket);
+    ClientMetrics::increment("gui_stall_handler." + handlerName);
+
+    qDebug() << "GUI-säie jumissa" << durationMs << "ms, käsittelijä:" << handlerName;
+}
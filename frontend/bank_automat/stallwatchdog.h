@@ -0,0 +1,53 @@
+#ifndef STALLWATCHDOG_H
+#define STALLWATCHDOG_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QPointer>
+#include <QThread>
+#include <QTimer>
+#include <atomic>
+
+// Vahtikoira: GUI-säie sykkii ajastimella, taustasäie huomaa kun sykkeet lakkaavat
+// (tapahtumasilmukka jumissa) ja kirjaa jumin keston sekä aktiivisen käsittelijän nimen.
+class StallWatchdog : public QObject
+{
+    Q_OBJECT
+public:
+    explicit StallWatchdog(int thresholdMs = 250, QObject *parent = nullptr);
+    ~StallWatchdog();
+
+    void start();
+
+    // Tällä hetkellä GUI-säikeessä suoritettava käsittelijä (asetetaan StallScope:lla)
+    static std::atomic<const char *> activeHandler;
+
+private:
+    void beat();
+    void monitor();
+    void recordStall(qint64 durationMs, const char *handler);
+
+    static const int HeartbeatIntervalMs = 50;
+
+    int thresholdMs;
+    QElapsedTimer clock;
+    QTimer *heartbeat;
+    QPointer<QThread> monitorThread;
+    std::atomic<qint64> lastBeatMs;
+    std::atomic<bool> stopping;
+};
+
+// Merkitsee käsittelijän aktiiviseksi näkyvyysalueensa ajaksi; nimen on oltava literaali
+class StallScope
+{
+public:
+    explicit StallScope(const char *name)
+        : previous(StallWatchdog::activeHandler.exchange(name, std::memory_order_relaxed)) {}
+    ~StallScope() { StallWatchdog::activeHandler.store(previous, std::memory_order_relaxed); }
+
+private:
+    Q_DISABLE_COPY(StallScope)
+    const char *previous;
+};
+
+#endif // STALLWATCHDOG_H
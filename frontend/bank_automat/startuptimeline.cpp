@@ -0,0 +1,45 @@
+#include "startuptimeline.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QPair>
+#include <QStringList>
+#include <QVector>
+
+namespace {
+
+QElapsedTimer startupTimer;
+QMutex milestonesMutex;
+QVector<QPair<const char *, qint64>> milestones;
+
+} // namespace
+
+void StartupTimeline::start()
+{
+    startupTimer.start();
+    mark("main");
+}
+
+void StartupTimeline::mark(const char *milestone)
+{
+    qint64 elapsedMs = startupTimer.isValid() ? startupTimer.elapsed() : 0;
+    {
+        QMutexLocker locker(&milestonesMutex);
+        milestones.append(qMakePair(milestone, elapsedMs));
+    }
+
+    if (qstrcmp(milestone, "idle_screen") == 0 && elapsedMs > IdleScreenBudgetMs) {
+        qDebug() << "Odotusnäyttö näkyi vasta" << elapsedMs << "ms kohdalla (tavoite" << IdleScreenBudgetMs << "ms)";
+    }
+}
+
+QString StartupTimeline::summary()
+{
+    QMutexLocker locker(&milestonesMutex);
+    QStringList parts;
+    for (const QPair<const char *, qint64> &milestone : milestones) {
+        parts << QString("%1 %2 ms").arg(QLatin1String(milestone.first)).arg(milestone.second);
+    }
+    return parts.join(", ");
+}
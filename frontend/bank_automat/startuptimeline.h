@@ -0,0 +1,22 @@
+#ifndef STARTUPTIMELINE_H
+#define STARTUPTIMELINE_H
+
+#include <QString>
+
+// Käynnistyksen aikajana: kirjaa kunkin vaiheen ajan (ms) main()-funktion alusta
+class StartupTimeline
+{
+public:
+    // Kutsutaan main()-funktion ensimmäisenä rivinä
+    static void start();
+
+    static void mark(const char *milestone);
+
+    // Tulostaa kaikki vaiheet yhdellä rivillä
+    static QString summary();
+
+    // Tavoite: odotusnäyttö näkyvissä alle 300 ms käynnistyksestä
+    static const int IdleScreenBudgetMs = 300;
+};
+
+#endif // STARTUPTIMELINE_H
@@ -0,0 +1,96 @@
+#include "telemetryreporter.h"
+#include "asynclogger.h"
+#include "clientmetrics.h"
+#include "requestcoalescer.h"
+#include <QDataStream>
+#include <QDateTime>
+#include <QFile>
+#include <QHostInfo>
+#include <QJsonObject>
+
+TelemetryReporter::TelemetryReporter(QObject *parent)
+    : QObject(parent), socket(new QUdpSocket(this)), timer(new QTimer(this)), port(0), sequence(0),
+      lastRequests(0), lastLatencyUs(0), lastErrors(0)
+{
+    connect(timer, &QTimer::timeout, this, &TelemetryReporter::sendFrame);
+}
+
+void TelemetryReporter::start()
+{
+    QString target = QString::fromLocal8Bit(qgetenv("ATM_TELEMETRY_ADDR"));
+    int separator = target.lastIndexOf(':');
+    if (separator <= 0) {
+        return;
+    }
+    port = target.mid(separator + 1).toUShort();
+    int intervalMs = qEnvironmentVariableIntValue("ATM_TELEMETRY_INTERVAL_MS");
+    if (intervalMs <= 0) {
+        intervalMs = 10000;
+    }
+
+    // Nimi selvitetään taustalla, jotta käynnistys ei odota DNS:ää
+    QHostInfo::lookupHost(target.left(separator), this, [this, intervalMs](const QHostInfo &info) {
+        if (info.error() != QHostInfo::NoError || info.addresses().isEmpty()) {
+            qCWarning(lcNetwork) << "Telemetriakohdetta ei löydy:" << info.errorString();
+            return;
+        }
+        address = info.addresses().first();
+        timer->start(intervalMs);
+    });
+}
+
+void TelemetryReporter::sendFrame()
+{
+    // Välin tunnusluvut lasketaan kumulatiivisten laskureiden erotuksina
+    qint64 requests = ClientMetrics::value("request_count");
+    qint64 latencyUs = ClientMetrics::value("request_latency_us_total");
+    qint64 errors = ClientMetrics::value("request_errors");
+    qint64 intervalRequests = requests - lastRequests;
+
+    QList<QPair<QByteArray, qint64>> values;
+    values.append(qMakePair(QByteArray("interval_requests"), intervalRequests));
+    values.append(qMakePair(QByteArray("interval_errors"), errors - lastErrors));
+    values.append(qMakePair(QByteArray("avg_latency_us"), intervalRequests > 0 ? (latencyUs - lastLatencyUs) / intervalRequests : qint64(0)));
+    values.append(qMakePair(QByteArray("rss_kb"), residentMemoryKb()));
+    lastRequests = requests;
+    lastLatencyUs = latencyUs;
+    lastErrors = errors;
+
+    QJsonObject snapshot = ClientMetrics::snapshot();
+    for (auto it = snapshot.constBegin(); it != snapshot.constEnd(); ++it) {
+        values.append(qMakePair(it.key().toUtf8(), static_cast<qint64>(it.value().toDouble())));
+    }
+
+    QByteArray frame;
+    QDataStream out(&frame, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_15);
+    out.writeRawData("ATMT", 4);
+    out << FrameVersion << RequestCoalescer::atmId() << QDateTime::currentMSecsSinceEpoch() << ++sequence;
+
+    // Määrä kirjoitetaan lopuksi paikalleen; loput laskurit jätetään pois, jos kehys kasvaisi liian suureksi
+    qint64 countPosition = frame.size();
+    out << quint16(0);
+    quint16 count = 0;
+    for (const auto &value : values) {
+        if (frame.size() + 4 + value.first.size() + 8 > MaxFrameBytes) {
+            break;
+        }
+        out << value.first << value.second;
+        count++;
+    }
+    out.device()->seek(countPosition);
+    out << count;
+
+    socket->writeDatagram(frame, address, port);
+}
+
+qint64 TelemetryReporter::residentMemoryKb()
+{
+    // Linux: /proc/self/statm, toinen kenttä on muistissa olevat sivut
+    QFile statm("/proc/self/statm");
+    if (!statm.open(QIODevice::ReadOnly)) {
+        return 0;
+    }
+    QList<QByteArray> fields = statm.readAll().split(' ');
+    return fields.size() > 1 ? fields.at(1).toLongLong() * 4 : 0;
+}
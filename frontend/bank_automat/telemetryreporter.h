@@ -0,0 +1,42 @@
+#ifndef TELEMETRYREPORTER_H
+#define TELEMETRYREPORTER_H
+
+#include <QHostAddress>
+#include <QObject>
+#include <QTimer>
+#include <QUdpSocket>
+
+// Lähettää määrävälein UDP-kehyksen automaatin tilasta keskitetylle koostajalle
+// (backend/tools/telemetry_aggregator.js). Kohde annetaan ATM_TELEMETRY_ADDR-muuttujalla
+// muodossa "host:portti"; ilman sitä raportointi on pois päältä.
+//
+// Kehys (QDataStream, big-endian): "ATMT" | quint8 versio | QByteArray automaatti |
+// qint64 aikaleima ms | quint32 järjestysnumero | quint16 n | n x (QByteArray nimi, qint64 arvo)
+class TelemetryReporter : public QObject
+{
+    Q_OBJECT
+public:
+    explicit TelemetryReporter(QObject *parent = nullptr);
+
+    void start();
+
+private slots:
+    void sendFrame();
+
+private:
+    static qint64 residentMemoryKb();
+
+    static const quint8 FrameVersion = 1;
+    static const int MaxFrameBytes = 1200;   // Mahtuu yhteen UDP-pakettiin ilman pilkkomista
+
+    QUdpSocket *socket;
+    QTimer *timer;
+    QHostAddress address;
+    quint16 port;
+    quint32 sequence;
+    qint64 lastRequests;
+    qint64 lastLatencyUs;
+    qint64 lastErrors;
+};
+
+#endif // TELEMETRYREPORTER_H
@@ -0,0 +1,117 @@
+#include "terminalregistry.h"
+#include "asynclogger.h"
+#include "clientmetrics.h"
+#include "mainwindow.h"
+#include "requestcoalescer.h"
+#include <QCoreApplication>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QPointer>
+
+namespace {
+
+// Korttitapahtumat tulevat lukijan säikeestä, joten taulut suojataan lukolla
+QMutex registryMutex;
+QHash<QString, QPointer<MainWindow>> terminalsByReader;
+QList<QPointer<MainWindow>> terminals;
+
+// Päätteen oma rinnakkaisuusraja päätepistettä kohden (RequestCoalescerin oletus)
+const int RequestsPerTerminal = 2;
+
+} // namespace
+
+QNetworkAccessManager *TerminalRegistry::networkManager()
+{
+    // Luodaan GUI-säikeessä ensimmäisen päätteen konstruktorissa
+    static QNetworkAccessManager *manager = new QNetworkAccessManager(QCoreApplication::instance());
+    return manager;
+}
+
+void TerminalRegistry::add(const QString &readerId, MainWindow *terminal)
+{
+    int active;
+    {
+        QMutexLocker locker(&registryMutex);
+        terminalsByReader.insert(readerId, terminal);
+        terminals.append(terminal);
+        active = terminals.size();
+    }
+    ClientMetrics::set("terminals", active);
+
+    // Jaettu koordinaattori rajoittaisi muuten kaikki päätteet yhden päätteen rajaan
+    RequestCoalescer::of(networkManager())->setDefaultLimit(RequestsPerTerminal * active);
+}
+
+void TerminalRegistry::remove(MainWindow *terminal)
+{
+    int active;
+    {
+        QMutexLocker locker(&registryMutex);
+        for (auto it = terminalsByReader.begin(); it != terminalsByReader.end();) {
+            if (it.value() == terminal || !it.value()) {
+                it = terminalsByReader.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        terminals.removeAll(terminal);
+        active = terminals.size();
+    }
+    ClientMetrics::set("terminals", active);
+
+    // Raja seuraa päätteiden määrää myös alaspäin, ettei jäljelle jäänyt pääte kuormita taustaa
+    // poistettujen osuudella
+    RequestCoalescer::of(networkManager())->setDefaultLimit(RequestsPerTerminal * qMax(active, 1));
+}
+
+MainWindow *TerminalRegistry::find(const QString &readerId)
+{
+    QMutexLocker locker(&registryMutex);
+    return terminalsByReader.value(readerId);
+}
+
+int TerminalRegistry::count()
+{
+    QMutexLocker locker(&registryMutex);
+    return terminals.size();
+}
+
+QStringList TerminalRegistry::configuredReaders()
+{
+    QStringList readers;
+    const QStringList configured = QString::fromLocal8Bit(qgetenv("ATM_READERS")).split(',');
+    for (const QString &reader : configured) {
+        if (!reader.trimmed().isEmpty()) {
+            readers << reader.trimmed();
+        }
+    }
+    if (readers.isEmpty()) {
+        readers << "COM3";
+    }
+    return readers;
+}
+
+void TerminalRegistry::dispatchCardRead(const QString &readerId, const QString &cardNumber)
+{
+    QPointer<MainWindow> terminal;
+    {
+        QMutexLocker locker(&registryMutex);
+        if (!readerId.isEmpty()) {
+            terminal = terminalsByReader.value(readerId);
+        } else if (terminals.size() == 1) {
+            terminal = terminals.first();
+        }
+    }
+    if (!terminal) {
+        qCWarning(lcCard) << "Korttitapahtumalle ei löydy päätettä, lukija:" << (readerId.isEmpty() ? QString("tuntematon") : readerId);
+        ClientMetrics::increment("card_events_unrouted");
+        return;
+    }
+
+    // Käsitellään päätteen säikeessä; jos pääte poistetaan ennen sitä, tapahtuma hylätään
+    QMetaObject::invokeMethod(terminal.data(), [terminal, cardNumber]() {
+        terminal->handleCardRead(cardNumber);
+    });
+}
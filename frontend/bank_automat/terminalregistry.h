@@ -0,0 +1,33 @@
+#ifndef TERMINALREGISTRY_H
+#define TERMINALREGISTRY_H
+
+#include <QNetworkAccessManager>
+#include <QString>
+#include <QStringList>
+
+class MainWindow;
+
+// Monipääteisäntä: yksi prosessi ajaa useaa automaatin käyttöliittymää (yksi MainWindow
+// lukijaa kohden). Päätteet jakavat verkkomanagerin (yhteysallas ja TLS-istunnot) sekä
+// ClientMetrics-laskurit; korttitapahtumat ohjataan päätteelle lukijan tunnisteen mukaan.
+class TerminalRegistry
+{
+public:
+    // Kaikkien päätteiden yhteinen verkkomanageri (luodaan tarvittaessa sovelluksen lapseksi)
+    static QNetworkAccessManager *networkManager();
+
+    static void add(const QString &readerId, MainWindow *terminal);
+    static void remove(MainWindow *terminal);
+    static MainWindow *find(const QString &readerId);
+    static int count();
+
+    // Lukijat ATM_READERS-muuttujasta pilkuilla eroteltuna, oletuksena COM3
+    static QStringList configuredReaders();
+
+    // Korttitapahtuma lukijakirjastolta (mistä tahansa säikeestä) lukijan päätteelle. Tyhjä
+    // readerId tarkoittaa, ettei kirjasto kerro lukijaa: tapahtuma annetaan vain, jos päätteitä
+    // on tasan yksi, eikä koskaan arvata päätettä.
+    static void dispatchCardRead(const QString &readerId, const QString &cardNumber);
+};
+
+#endif // TERMINALREGISTRY_H
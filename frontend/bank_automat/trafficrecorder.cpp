@@ -0,0 +1,64 @@
+#include "trafficrecorder.h"
+#include <QDataStream>
+#include <QDebug>
+#include <QFile>
+#include <QRegularExpression>
+
+namespace {
+
+QFile *captureFile()
+{
+    static QFile *file = nullptr;
+    static bool initialized = false;
+    if (!initialized) {
+        initialized = true;
+        QString path = QString::fromLocal8Bit(qgetenv("ATM_CAPTURE_FILE"));
+        if (!path.isEmpty()) {
+            file = new QFile(path);
+            bool exists = file->exists() && file->size() > 0;
+            if (!file->open(QIODevice::WriteOnly | QIODevice::Append)) {
+                qDebug() << "Kaappaustiedoston avaus epäonnistui:" << path;
+                delete file;
+                file = nullptr;
+            } else if (!exists) {
+                file->write("ATMCAP1\n");
+            }
+        }
+    }
+    return file;
+}
+
+} // namespace
+
+bool TrafficRecorder::isEnabled()
+{
+    return captureFile() != nullptr;
+}
+
+QByteArray TrafficRecorder::redact(const QByteArray &body)
+{
+    static const QRegularExpression pinPattern("(\"pin_code\"\\s*:\\s*)\"[^\"]*\"");
+    QString text = QString::fromUtf8(body);
+    text.replace(pinPattern, "\\1\"****\"");
+    return text.toUtf8();
+}
+
+void TrafficRecorder::record(const QByteArray &traceId, const QNetworkRequest &request, const QByteArray &requestBody,
+                             const CoalescedReply &reply, qint64 startUs, qint64 endUs)
+{
+    QFile *file = captureFile();
+    if (!file) {
+        return;
+    }
+
+    QDataStream stream(file);
+    stream.setByteOrder(QDataStream::BigEndian);
+    stream << startUs
+           << (endUs - startUs)
+           << traceId
+           << request.url().path().toUtf8()
+           << redact(requestBody)
+           << static_cast<qint32>(reply.httpStatus)
+           << reply.body;
+    file->flush();
+}
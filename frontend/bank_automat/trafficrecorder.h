@@ -0,0 +1,26 @@
+#ifndef TRAFFICRECORDER_H
+#define TRAFFICRECORDER_H
+
+#include <QByteArray>
+#include <QNetworkRequest>
+#include "requestcoalescer.h"
+
+// Tallentaa jokaisen pyyntö/vastaus-parin ajoituksineen binääritiedostoon, jos
+// ATM_CAPTURE_FILE on asetettu. PIN-koodit peitetään ennen kirjoitusta.
+//
+// Tiedostomuoto: otsake "ATMCAP1\n", sen jälkeen tietueita QDataStreamin (big-endian)
+// muodossa: qint64 startUs, qint64 durationUs, QByteArray traceId, QByteArray path,
+// QByteArray requestBody, qint32 httpStatus, QByteArray responseBody.
+// Toistotyökalu: backend/tools/replay.js
+class TrafficRecorder
+{
+public:
+    static bool isEnabled();
+    static void record(const QByteArray &traceId, const QNetworkRequest &request, const QByteArray &requestBody,
+                       const CoalescedReply &reply, qint64 startUs, qint64 endUs);
+
+    // Korvaa "pin_code"-kentän arvon tähdillä
+    static QByteArray redact(const QByteArray &body);
+};
+
+#endif // TRAFFICRECORDER_H